@@ -0,0 +1,110 @@
+#include "BenchmarkReport.h"
+#include <iostream>
+#include <map>
+
+juce::String BenchmarkResult::getKey() const
+{
+    juce::String key = suite + "/" + name;
+
+    for (auto& parameter : parameters)
+    {
+        key << "/" << parameter.name.toString() << "=" << parameter.value.toString();
+    }
+
+    return key;
+}
+
+void BenchmarkReport::add(const BenchmarkResult& result)
+{
+    juce::String line = result.getKey().paddedRight(' ', 60) + juce::String(result.value, 3) + " " + result.unit;
+
+    for (auto& extra : result.extras)
+    {
+        line << "  " << extra.name.toString() << " " << juce::String((double) extra.value, 3);
+    }
+
+    std::cout << line << std::endl;
+    results.push_back(result);
+}
+
+bool BenchmarkReport::writeJson(const juce::File& file) const
+{
+    juce::Array<juce::var> entries;
+
+    for (auto& result : results)
+    {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty("key", result.getKey());
+        entry->setProperty("suite", result.suite);
+        entry->setProperty("name", result.name);
+        entry->setProperty("value", result.value);
+        entry->setProperty("unit", result.unit);
+
+        auto* parameters = new juce::DynamicObject();
+        for (auto& parameter : result.parameters)
+        {
+            parameters->setProperty(parameter.name, parameter.value);
+        }
+
+        auto* extras = new juce::DynamicObject();
+        for (auto& extra : result.extras)
+        {
+            extras->setProperty(extra.name, extra.value);
+        }
+
+        entry->setProperty("parameters", juce::var(parameters));
+        entry->setProperty("extras", juce::var(extras));
+        entries.add(juce::var(entry));
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("system", juce::SystemStats::getCpuModel());
+    report->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+    report->setProperty("results", entries);
+
+    return file.replaceWithText(juce::JSON::toString(juce::var(report)));
+}
+
+int BenchmarkReport::compareWithBaseline(const juce::File& file, double tolerance) const
+{
+    auto baseline = juce::JSON::parse(file);
+
+    if (! baseline.isObject())
+    {
+        std::cout << "couldn't read a baseline from " << file.getFullPathName() << std::endl;
+        return -1;
+    }
+
+    std::map<juce::String, double> baselineValues;
+
+    if (auto* entries = baseline["results"].getArray())
+    {
+        for (auto& entry : *entries)
+        {
+            baselineValues[entry["key"].toString()] = (double) entry["value"];
+        }
+    }
+
+    int numRegressions = 0;
+    std::cout << std::endl << "compared with " << file.getFullPathName() << std::endl;
+
+    for (auto& result : results)
+    {
+        auto match = baselineValues.find(result.getKey());
+
+        if (match == baselineValues.end() || match->second <= 0.0)
+        {
+            std::cout << result.getKey().paddedRight(' ', 60) << "new" << std::endl;
+            continue;
+        }
+
+        double change = result.value / match->second - 1.0;
+        bool isRegression = change > tolerance;
+        numRegressions += isRegression ? 1 : 0;
+
+        std::cout << result.getKey().paddedRight(' ', 60) << (change >= 0.0 ? "+" : "") << juce::String(change * 100.0, 1) << "%"
+                  << (isRegression ? "  slower" : "") << std::endl;
+    }
+
+    return numRegressions;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <JuceHeader.h>
+#include <limits>
+
+// One measurement. value is the headline number, lower is better, and is what
+// baselines are compared on. extras holds anything else worth printing and
+// keeping, such as bytes per cycle.
+struct BenchmarkResult
+{
+    juce::String suite;
+    juce::String name;
+    juce::NamedValueSet parameters;
+    double value = 0.0;
+    juce::String unit;
+    juce::NamedValueSet extras;
+
+    // suite, name and parameters, e.g. "kernels/window/block=512/grainLength=4800"
+    juce::String getKey() const;
+};
+
+// Collects the results of a run, prints each as it comes in, and writes them
+// out as JSON that a later run can be compared against.
+class BenchmarkReport
+{
+public:
+    void add(const BenchmarkResult& result);
+
+    bool writeJson(const juce::File& file) const;
+
+    // prints how every result changed from a report saved by writeJson, and returns
+    // how many got slower by more than tolerance, 0.1 being 10%
+    int compareWithBaseline(const juce::File& file, double tolerance) const;
+
+private:
+    std::vector<BenchmarkResult> results;
+};
+
+// fastest of several runs of function, in seconds, after one run to warm the caches up
+template <typename Function>
+double measureSeconds(int numRuns, Function&& function)
+{
+    function();
+    double fastest = std::numeric_limits<double>::max();
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        function();
+        fastest = std::min(fastest, juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+    }
+
+    return fastest;
+}
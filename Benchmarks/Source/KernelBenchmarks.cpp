@@ -0,0 +1,366 @@
+#include "KernelBenchmarks.h"
+#include "../../Source/GrainWindow.h"
+#include "../../Source/GrainFilterBank.h"
+#include "../../Source/MicroGrainCloud.h"
+#include "../../Source/GrainProcessor.h"
+
+namespace
+{
+    constexpr int numRuns = 5;
+    constexpr double sampleRate = 48000.0;
+    constexpr int numChannels = 2;
+    constexpr int samplesPerRun = 48000;                        // one second of output per run
+    constexpr int ringBufferSize = (int) (4.0 * sampleRate);    // the plugin's delay buffer at 48 kHz
+
+    const int blockSizes[] = { 64, 512, 2048 };
+
+    void store(float& destination, float value)     { destination = value; }
+    void store(Float16& destination, float value)   { destination = Float16::fromFloat(value); }
+
+    template <typename SampleType>
+    const char* getStorageName()
+    {
+        return std::is_same<SampleType, Float16>::value ? "float16" : "float32";
+    }
+
+    template <typename SampleType>
+    DelayStorage getDelayStorage()
+    {
+        return std::is_same<SampleType, Float16>::value ? DelayStorage::float16 : DelayStorage::float32;
+    }
+
+    void fillWithNoise(juce::AudioBuffer<float>& buffer, juce::Random& random)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                buffer.setSample(channel, i, (random.nextFloat() * 2.0f - 1.0f) * 0.5f);
+            }
+        }
+    }
+
+    // a delay buffer full of noise, in either storage
+    template <typename SampleType>
+    struct RingBuffer
+    {
+        RingBuffer()
+        {
+            juce::Random random(1);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                channels[channel].resize((size_t) ringBufferSize);
+                for (auto& sample : channels[channel])
+                {
+                    store(sample, (random.nextFloat() * 2.0f - 1.0f) * 0.5f);
+                }
+
+                pointers[channel] = channels[channel].data();
+            }
+        }
+
+        std::vector<SampleType> channels[numChannels];
+        SampleType* pointers[numChannels];
+    };
+
+    void addResult(BenchmarkReport& report, const juce::String& name, const juce::NamedValueSet& parameters,
+                   double seconds, double numSamples, double numBytes)
+    {
+        static const double cyclesPerSecond = juce::SystemStats::getCpuSpeedInMegahertz() * 1.0e6;
+
+        BenchmarkResult result;
+        result.suite = "kernels";
+        result.name = name;
+        result.parameters = parameters;
+        result.value = seconds * 1.0e9 / numSamples;
+        result.unit = "ns/sample";
+
+        if (cyclesPerSecond > 0.0)
+        {
+            result.extras.set("bytesPerCycle", numBytes / (seconds * cyclesPerSecond));
+        }
+
+        report.add(result);
+    }
+
+    // a processor prepared for the given block size with its delay buffer already full of noise, so
+    // the amplitude index the grains are culled with describes what they read
+    template <typename SampleType>
+    std::unique_ptr<GrainProcessor> createProcessor(int blockSize)
+    {
+        auto processor = std::make_unique<GrainProcessor>();
+        processor->setDelayStorage(getDelayStorage<SampleType>());
+        processor->prepare(sampleRate, blockSize);
+
+        juce::Random random(2);
+        juce::AudioBuffer<float> input(numChannels, blockSize);
+
+        for (int written = 0; written < ringBufferSize; written += blockSize)
+        {
+            fillWithNoise(input, random);
+            processor->writeBlock(input);
+        }
+
+        return processor;
+    }
+
+    // the input written into the delay buffer block by block through GrainProcessor::writeBlock, with the
+    // feedback saturated in and DC blocked when it's on, and the amplitude and zero crossing indices updated,
+    // no grains are read here so the feedback is silence, which costs the same as a loud loop
+    template <typename SampleType>
+    void benchmarkDelayWrite(BenchmarkReport& report, int blockSize, bool hasFeedback)
+    {
+        auto processor = createProcessor<SampleType>(blockSize);
+        processor->setFeedback(hasFeedback ? 0.5 : 0.0);
+
+        juce::Random random(2);
+        juce::AudioBuffer<float> input(numChannels, blockSize);
+        fillWithNoise(input, random);
+
+        int numBlocks = samplesPerRun / blockSize;
+
+        double seconds = measureSeconds(numRuns, [&]
+        {
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                processor->writeBlock(input);
+            }
+        });
+
+        juce::NamedValueSet parameters;
+        parameters.set("storage", getStorageName<SampleType>());
+        parameters.set("block", blockSize);
+        parameters.set("feedback", hasFeedback ? "on" : "off");
+
+        // the input read and the ring written, the feedback read and blocked in place, the indices aren't counted
+        double numSamples = (double) numBlocks * blockSize;
+        double bytesPerSample = sizeof(float) + sizeof(SampleType) + (hasFeedback ? 2 * sizeof(float) : 0);
+        addResult(report, "delayWrite", parameters, seconds, numSamples, numSamples * numChannels * bytesPerSample);
+    }
+
+    // grains read back out of the delay buffer through GrainProcessor::mixGrain, restarting somewhere else as they
+    // finish, panned anywhere within half the width so the level culling and gains are those a spread cloud gets
+    template <typename SampleType>
+    void benchmarkWindow(BenchmarkReport& report, WindowShape shape, bool isReversed, int blockSize, int grainLength, int numGrains)
+    {
+        WindowTables tables;
+        auto processor = createProcessor<SampleType>(blockSize);
+        juce::Random random(3);
+        juce::AudioBuffer<float> output(numChannels, blockSize);
+        std::vector<Grain> grains;
+        grains.reserve((size_t) numGrains);
+
+        auto createGrain = [&]
+        {
+            return Grain(0, grainLength, (random.nextDouble() * 2.0 - 1.0) * 0.5, isReversed, false, random.nextInt(ringBufferSize), 0,
+                         GrainWindow(shape, 0.5, grainLength, tables));
+        };
+
+        // staggered, so the grains don't all restart in the same block
+        for (int i = 0; i < numGrains; ++i)
+        {
+            grains.push_back(createGrain());
+            auto& grain = grains.back();
+            int stagger = random.nextInt(grainLength);
+            grain.window.advance(stagger);
+            grain.writeIndex = stagger;
+        }
+
+        int numBlocks = std::max(1, samplesPerRun / blockSize);
+
+        double seconds = measureSeconds(numRuns, [&]
+        {
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                output.clear();
+
+                for (auto& grain : grains)
+                {
+                    // a grain finishing partway through the block is replaced by one starting where it stopped
+                    for (int done = 0; done < blockSize;)
+                    {
+                        if (grain.writeIndex >= grain.size)
+                        {
+                            grain = createGrain();
+                            grain.relativeStartIndex = done;
+                        }
+
+                        int start = grain.writeIndex == 0 ? grain.relativeStartIndex : 0;
+                        done = start + processor->mixGrain(output, grain, output.getArrayOfWritePointers());
+                    }
+                }
+            }
+        });
+
+        juce::NamedValueSet parameters;
+        parameters.set("storage", getStorageName<SampleType>());
+        parameters.set("shape", GrainWindow::getShapeNames()[(int) shape]);
+        parameters.set("direction", isReversed ? "backwards" : "forwards");
+        parameters.set("block", blockSize);
+        parameters.set("grainLength", grainLength);
+        parameters.set("grains", numGrains);
+
+        // each grain sample reads the source and reads and writes the output, per channel, culled channels still count
+        double numSamples = (double) numBlocks * blockSize * numGrains;
+        addResult(report, "window", parameters, seconds, numSamples, numSamples * numChannels * (sizeof(SampleType) + 2 * sizeof(float)));
+    }
+
+    // grains filtered laneCount at a time and added into one channel, as GrainProcessor::mixFilteredGrains does
+    void benchmarkFilterBank(BenchmarkReport& report, GrainFilterMode mode, int blockSize, int numGrains)
+    {
+        constexpr int laneCount = GrainFilterBank::laneCount;
+
+        GrainFilterBank filters;
+        filters.prepare(numGrains);
+
+        juce::Random random(4);
+        std::vector<int> slots;
+        for (int grain = 0; grain < numGrains; ++grain)
+        {
+            // spread over the range the filter spread parameter reaches
+            slots.push_back(filters.add(mode, 200.0 * std::pow(2.0, random.nextDouble() * 6.0), 2.0, sampleRate));
+        }
+
+        juce::AudioBuffer<float> inputs(laneCount, blockSize);
+        juce::AudioBuffer<float> output(numChannels, blockSize);
+        fillWithNoise(inputs, random);
+
+        const float* inputPointers[laneCount];
+        for (int lane = 0; lane < laneCount; ++lane)
+        {
+            inputPointers[lane] = inputs.getReadPointer(lane);
+        }
+
+        int numBlocks = std::max(1, samplesPerRun / blockSize);
+
+        double seconds = measureSeconds(numRuns, [&]
+        {
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                output.clear();
+
+                for (int channel = 0; channel < numChannels; ++channel)
+                {
+                    for (int first = 0; first < numGrains; first += laneCount)
+                    {
+                        filters.process(slots.data() + first, std::min(laneCount, numGrains - first), inputPointers,
+                                        output.getWritePointer(channel), channel, blockSize);
+                    }
+                }
+            }
+        });
+
+        juce::NamedValueSet parameters;
+        parameters.set("mode", GrainFilterBank::getModeNames()[(int) mode]);
+        parameters.set("block", blockSize);
+        parameters.set("grains", numGrains);
+
+        // every lane reads its input, every group of lanes reads and writes the output once
+        int numGroups = (numGrains + laneCount - 1) / laneCount;
+        double numSamples = (double) numBlocks * blockSize * numGrains;
+        double numBytes = numBlocks * blockSize * numChannels * ((double) numGrains * sizeof(float) + numGroups * 2.0 * sizeof(float));
+        addResult(report, "filterBank", parameters, seconds, numSamples, numBytes);
+    }
+
+    // a cloud kept topped up to numGrains grains of grainLength samples, mixed out of the delay buffer
+    template <typename SampleType>
+    void benchmarkMicroGrains(BenchmarkReport& report, int blockSize, int grainLength, int numGrains)
+    {
+        RingBuffer<SampleType> ring;
+        MicroGrainCloud cloud;
+        cloud.prepare();
+
+        juce::Random random(5);
+        juce::AudioBuffer<float> output(numChannels, blockSize);
+        int numBlocks = std::max(1, samplesPerRun / blockSize);
+
+        double seconds = measureSeconds(numRuns, [&]
+        {
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                output.clear();
+
+                while (cloud.getNumActive() < numGrains)
+                {
+                    cloud.add(random.nextInt(ringBufferSize), 0, grainLength, random.nextFloat() * 2.0f - 1.0f);
+                }
+
+                cloud.mix(ring.pointers, ringBufferSize, output.getArrayOfWritePointers(), numChannels, blockSize);
+            }
+        });
+
+        juce::NamedValueSet parameters;
+        parameters.set("storage", getStorageName<SampleType>());
+        parameters.set("block", blockSize);
+        parameters.set("grainLength", grainLength);
+        parameters.set("grains", numGrains);
+
+        // grains finishing partway through a block are only replaced in the next, so this slightly overcounts
+        double numSamples = (double) numBlocks * blockSize * numGrains;
+        addResult(report, "microGrains", parameters, seconds, numSamples, numSamples * numChannels * (sizeof(SampleType) + 2 * sizeof(float)));
+    }
+
+    template <typename SampleType>
+    void runForStorage(BenchmarkReport& report)
+    {
+        for (int blockSize : blockSizes)
+        {
+            for (bool hasFeedback : { false, true })
+            {
+                benchmarkDelayWrite<SampleType>(report, blockSize, hasFeedback);
+            }
+        }
+
+        // 10 ms, 100 ms and 1 s grains
+        for (int blockSize : blockSizes)
+        {
+            for (int grainLength : { 480, 4800, 48000 })
+            {
+                for (int numGrains : { 1, 16, 128 })
+                {
+                    benchmarkWindow<SampleType>(report, WindowShape::hann, false, blockSize, grainLength, numGrains);
+                }
+            }
+        }
+
+        for (int shape = 0; shape < GrainWindow::getShapeNames().size(); ++shape)
+        {
+            for (bool isReversed : { false, true })
+            {
+                benchmarkWindow<SampleType>(report, (WindowShape) shape, isReversed, 512, 4800, 16);
+            }
+        }
+
+        // 2 ms and 20 ms micro grains
+        for (int blockSize : blockSizes)
+        {
+            for (int grainLength : { 96, 960 })
+            {
+                for (int numGrains : { 64, 256, MicroGrainCloud::capacity })
+                {
+                    benchmarkMicroGrains<SampleType>(report, blockSize, grainLength, numGrains);
+                }
+            }
+        }
+    }
+}
+
+void KernelBenchmarks::run(BenchmarkReport& report)
+{
+    runForStorage<float>(report);
+    runForStorage<Float16>(report);
+
+    for (int blockSize : blockSizes)
+    {
+        for (int numGrains : { 4, 16, 64 })
+        {
+            benchmarkFilterBank(report, GrainFilterMode::lowPass, blockSize, numGrains);
+        }
+    }
+
+    for (auto mode : { GrainFilterMode::bandPass, GrainFilterMode::highPass })
+    {
+        benchmarkFilterBank(report, mode, 512, 16);
+    }
+}
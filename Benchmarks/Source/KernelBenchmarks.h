@@ -0,0 +1,14 @@
+#pragma once
+#include "BenchmarkReport.h"
+
+// The grain engine's inner loops on their own, outside the plugin: writing the
+// delay buffer and reading it back through a grain window, both through the
+// GrainProcessor's own code, the grain filter bank and the micro grain cloud.
+// Each is swept over block size, grain length and grain count, for float and
+// Float16 storage where the kernel reads the delay buffer, and reported in ns
+// per sample of each grain, with bytes per cycle worked out from the CPU's
+// nominal clock.
+namespace KernelBenchmarks
+{
+    void run(BenchmarkReport& report);
+}
@@ -0,0 +1,57 @@
+#include <JuceHeader.h>
+#include <iostream>
+#include "BenchmarkReport.h"
+#include "StartupBenchmark.h"
+#include "KernelBenchmarks.h"
+
+// ShatterBenchmarks [startup] [kernels] [--instances n] [--json results.json] [--baseline baseline.json] [--tolerance 0.1]
+// runs every suite when none is named, and returns 1 when anything is slower than the baseline by more than the tolerance
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray arguments;
+    for (int i = 1; i < argc; ++i)
+    {
+        arguments.add(argv[i]);
+    }
+
+    auto getOption = [&arguments] (const juce::String& name, const juce::String& defaultValue)
+    {
+        int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments[index + 1] : defaultValue;
+    };
+
+    auto shouldRun = [&arguments] (const juce::String& suite)
+    {
+        return arguments.contains(suite) || ! (arguments.contains("startup") || arguments.contains("kernels"));
+    };
+
+    BenchmarkReport report;
+
+    if (shouldRun("startup"))
+    {
+        StartupBenchmark::run(report, getOption("--instances", "100").getIntValue());
+    }
+
+    if (shouldRun("kernels"))
+    {
+        KernelBenchmarks::run(report);
+    }
+
+    auto jsonPath = getOption("--json", {});
+    if (jsonPath.isNotEmpty() && ! report.writeJson(juce::File::getCurrentWorkingDirectory().getChildFile(jsonPath)))
+    {
+        std::cout << "couldn't write " << jsonPath << std::endl;
+        return 1;
+    }
+
+    auto baselinePath = getOption("--baseline", {});
+    if (baselinePath.isNotEmpty())
+    {
+        double tolerance = getOption("--tolerance", "0.1").getDoubleValue();
+        return report.compareWithBaseline(juce::File::getCurrentWorkingDirectory().getChildFile(baselinePath), tolerance) == 0 ? 0 : 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "StartupBenchmark.h"
+#include "../../Source/PluginProcessor.h"
+
+namespace
+{
+    constexpr int numRuns = 5;
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+
+    void prepare(ShatterAudioProcessor& processor)
+    {
+        processor.setPlayConfigDetails(2, 2, sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+    }
+}
+
+void StartupBenchmark::run(BenchmarkReport& report, int numInstances)
+{
+    std::vector<std::unique_ptr<ShatterAudioProcessor>> instances((size_t) numInstances);
+
+    auto construct = [&instances]
+    {
+        for (auto& instance : instances)
+        {
+            instance = std::make_unique<ShatterAudioProcessor>();
+        }
+    };
+
+    auto destroy = [&instances]
+    {
+        for (auto& instance : instances)
+        {
+            instance.reset();
+        }
+    };
+
+    auto prepareAll = [&instances]
+    {
+        for (auto& instance : instances)
+        {
+            prepare(*instance);
+        }
+    };
+
+    auto releaseAll = [&instances]
+    {
+        for (auto& instance : instances)
+        {
+            instance->releaseResources();
+        }
+    };
+
+    // each stage is timed on its own, the others run untimed around it to keep the instances in the right state
+    double constructTime = std::numeric_limits<double>::max();
+    double prepareTime = std::numeric_limits<double>::max();
+    double reprepareTime = std::numeric_limits<double>::max();
+    double releaseTime = std::numeric_limits<double>::max();
+    double destroyTime = std::numeric_limits<double>::max();
+
+    auto time = [] (double& fastest, auto&& stage)
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+        stage();
+        fastest = std::min(fastest, juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+    };
+
+    for (int run = 0; run < numRuns; ++run)
+    {
+        time(constructTime, construct);
+        time(prepareTime, prepareAll);
+        time(reprepareTime, prepareAll);
+        time(releaseTime, releaseAll);
+        time(destroyTime, destroy);
+    }
+
+    double bypassedTime = measureSeconds(numRuns, [&construct, &destroy]
+    {
+        construct();
+        destroy();
+    });
+
+    auto addResult = [&report, numInstances] (const char* name, double seconds)
+    {
+        BenchmarkResult result;
+        result.suite = "startup";
+        result.name = name;
+        result.parameters.set("instances", numInstances);
+        result.value = seconds * 1.0e6 / numInstances;
+        result.unit = "us/instance";
+        report.add(result);
+    };
+
+    addResult("construct", constructTime);
+    addResult("prepare", prepareTime);
+    addResult("prepareAgain", reprepareTime);
+    addResult("release", releaseTime);
+    addResult("destroy", destroyTime);
+    addResult("constructAndDestroyUnprepared", bypassedTime);
+}
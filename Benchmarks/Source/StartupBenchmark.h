@@ -0,0 +1,11 @@
+#pragma once
+#include "BenchmarkReport.h"
+
+// What a host pays for each instance while it scans plugins or reloads a session:
+// constructing, preparing, preparing again with the same settings, releasing and
+// destroying, each timed across a batch of instances. Instances that are
+// constructed and destroyed without ever being prepared stand in for bypassed ones.
+namespace StartupBenchmark
+{
+    void run(BenchmarkReport& report, int numInstances);
+}
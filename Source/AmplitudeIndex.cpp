@@ -0,0 +1,243 @@
+#include "AmplitudeIndex.h"
+
+void AmplitudeIndex::prepare(int ringBufferSize)
+{
+    bufferSize = ringBufferSize;
+    numBlocks = (bufferSize + blockSize - 1) / blockSize;
+    numLeaves = juce::nextPowerOfTwo(numBlocks);
+
+    peakTree.assign((size_t) numLeaves * 2, 0.0f);
+    weightTree.assign((size_t) numLeaves * 2, 0.0f);
+    energies.assign((size_t) numBlocks, 0.0f);
+
+    rebuildWeights();
+}
+
+void AmplitudeIndex::release()
+{
+    bufferSize = numBlocks = numLeaves = 0;
+
+    std::vector<float>().swap(peakTree);
+    std::vector<float>().swap(weightTree);
+    std::vector<float>().swap(energies);
+}
+
+template <typename SampleType>
+void AmplitudeIndex::update(const SampleType* const* ringBuffer, int numChannels, int startSample, int numSamples)
+{
+    int firstRunLength = std::min(numSamples, bufferSize - startSample);
+    updateBlocks(ringBuffer, numChannels, startSample / blockSize, (startSample + firstRunLength - 1) / blockSize);
+
+    if (firstRunLength < numSamples)
+    {
+        updateBlocks(ringBuffer, numChannels, 0, (numSamples - firstRunLength - 1) / blockSize);
+    }
+}
+
+float AmplitudeIndex::getPeak(int startSample, int numSamples) const
+{
+    if (numSamples <= 0)
+    {
+        return 0.0f;
+    }
+
+    int firstRunLength = std::min(numSamples, bufferSize - startSample);
+    float peak = getPeakOfBlocks(startSample / blockSize, (startSample + firstRunLength - 1) / blockSize);
+
+    if (firstRunLength < numSamples)
+    {
+        peak = std::max(peak, getPeakOfBlocks(0, (numSamples - firstRunLength - 1) / blockSize));
+    }
+
+    return peak;
+}
+
+void AmplitudeIndex::setPlacement(GrainPlacement newPlacement)
+{
+    if (newPlacement != placement)
+    {
+        placement = newPlacement;
+        rebuildWeights();
+    }
+}
+
+void AmplitudeIndex::rebuildWeights()
+{
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        weightTree[(size_t) (numLeaves + block)] = getWeight(block);
+    }
+
+    for (int node = numLeaves - 1; node > 0; --node)
+    {
+        weightTree[(size_t) node] = weightTree[(size_t) node * 2] + weightTree[(size_t) node * 2 + 1];
+    }
+}
+
+int AmplitudeIndex::pickPosition(int startSample, int numSamples, float randomValue, float randomOffset) const
+{
+    if (numSamples <= 0)
+    {
+        return -1;
+    }
+
+    int firstRunLength = std::min(numSamples, bufferSize - startSample);
+    int secondRunLength = numSamples - firstRunLength;
+
+    float firstRunWeight = getWeightOfBlocks(startSample / blockSize, (startSample + firstRunLength - 1) / blockSize);
+    float secondRunWeight = secondRunLength > 0 ? getWeightOfBlocks(0, (secondRunLength - 1) / blockSize) : 0.0f;
+
+    if (firstRunWeight + secondRunWeight <= 0.0f)
+    {
+        return -1;
+    }
+
+    float target = randomValue * (firstRunWeight + secondRunWeight);
+
+    if (target < firstRunWeight || secondRunLength == 0)
+    {
+        return pickPositionInRun(startSample, firstRunLength, std::min(target, firstRunWeight), randomOffset);
+    }
+
+    return pickPositionInRun(0, secondRunLength, target - firstRunWeight, randomOffset);
+}
+
+juce::StringArray AmplitudeIndex::getPlacementNames()
+{
+    return { "Uniform", "Avoid Silence", "Loudness", "Transients" };
+}
+
+template <typename SampleType>
+void AmplitudeIndex::updateBlocks(const SampleType* const* ringBuffer, int numChannels, int firstBlock, int lastBlock)
+{
+    for (int block = firstBlock; block <= lastBlock; ++block)
+    {
+        int blockStart = block * blockSize;
+        int blockLength = std::min(blockSize, bufferSize - blockStart);
+        int node = numLeaves + block;
+
+        float energy = 0.0f;
+        float peak = 0.0f;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            for (int i = blockStart; i < blockStart + blockLength; ++i)
+            {
+                float sample = toFloat(ringBuffer[channel][i]);
+                energy += sample * sample;
+                peak = std::max(peak, std::abs(sample));
+            }
+        }
+
+        energies[(size_t) block] = energy / (blockLength * std::max(1, numChannels));
+        peakTree[(size_t) node] = peak;
+
+        for (node /= 2; node > 0; node /= 2)
+        {
+            peakTree[(size_t) node] = std::max(peakTree[(size_t) node * 2], peakTree[(size_t) node * 2 + 1]);
+        }
+
+        updateWeight(block);
+    }
+}
+
+void AmplitudeIndex::updateWeight(int block)
+{
+    int node = numLeaves + block;
+    weightTree[(size_t) node] = getWeight(block);
+
+    for (node /= 2; node > 0; node /= 2)
+    {
+        weightTree[(size_t) node] = weightTree[(size_t) node * 2] + weightTree[(size_t) node * 2 + 1];
+    }
+}
+
+float AmplitudeIndex::getWeight(int block) const
+{
+    switch (placement)
+    {
+        case GrainPlacement::avoidSilence:  return peakTree[(size_t) (numLeaves + block)] >= silenceFloor ? 1.0f : 0.0f;
+        case GrainPlacement::loudness:      return std::sqrt(energies[(size_t) block]);
+        case GrainPlacement::transients:    return isTransient(block) ? 1.0f : 0.0f;
+        case GrainPlacement::uniform:
+        default:                            return 1.0f;
+    }
+}
+
+bool AmplitudeIndex::isTransient(int block) const
+{
+    // a block much louder than the few just before it
+    float recentEnergy = 0.0f;
+    for (int i = 1; i <= transientHistory; ++i)
+    {
+        recentEnergy += energies[(size_t) ((block - i + numBlocks) % numBlocks)];
+    }
+
+    float energy = energies[(size_t) block];
+    return energy > silenceFloor * silenceFloor && energy > transientRatio * recentEnergy / transientHistory;
+}
+
+float AmplitudeIndex::getPeakOfBlocks(int firstBlock, int lastBlock) const
+{
+    float peak = 0.0f;
+
+    // walk up from both ends, taking in the nodes that sit wholly inside the range
+    for (int left = numLeaves + firstBlock, right = numLeaves + lastBlock + 1; left < right; left /= 2, right /= 2)
+    {
+        if (left & 1)   { peak = std::max(peak, peakTree[(size_t) left++]); }
+        if (right & 1)  { peak = std::max(peak, peakTree[(size_t) --right]); }
+    }
+
+    return peak;
+}
+
+float AmplitudeIndex::getWeightOfBlocks(int firstBlock, int lastBlock) const
+{
+    float weight = 0.0f;
+
+    for (int left = numLeaves + firstBlock, right = numLeaves + lastBlock + 1; left < right; left /= 2, right /= 2)
+    {
+        if (left & 1)   { weight += weightTree[(size_t) left++]; }
+        if (right & 1)  { weight += weightTree[(size_t) --right]; }
+    }
+
+    return weight;
+}
+
+int AmplitudeIndex::findBlock(float weightBefore) const
+{
+    // descend towards the leaf where the running total passes weightBefore
+    int node = 1;
+
+    while (node < numLeaves)
+    {
+        node *= 2;
+
+        if (weightBefore >= weightTree[(size_t) node])
+        {
+            weightBefore -= weightTree[(size_t) node];
+            ++node;
+        }
+    }
+
+    return node - numLeaves;
+}
+
+int AmplitudeIndex::pickPositionInRun(int runStart, int runLength, float weightIntoRun, float randomOffset) const
+{
+    int firstBlock = runStart / blockSize;
+    int lastBlock = (runStart + runLength - 1) / blockSize;
+
+    float weightBeforeRun = firstBlock > 0 ? getWeightOfBlocks(0, firstBlock - 1) : 0.0f;
+
+    // rounding in the sums can land a little outside the run, or on a block without weight
+    int block = juce::jlimit(firstBlock, lastBlock, findBlock(weightBeforeRun + weightIntoRun));
+
+    int blockStart = std::max(runStart, block * blockSize);
+    int blockEnd = std::min(runStart + runLength, (block + 1) * blockSize);
+
+    return blockStart + std::min(blockEnd - blockStart - 1, (int) (randomOffset * (blockEnd - blockStart)));
+}
+
+template void AmplitudeIndex::update<float>(const float* const*, int, int, int);
+template void AmplitudeIndex::update<Float16>(const Float16* const*, int, int, int);
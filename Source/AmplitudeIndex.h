@@ -0,0 +1,69 @@
+#pragma once
+#include <JuceHeader.h>
+#include "Float16.h"
+
+enum class GrainPlacement
+{
+    uniform = 0,
+    avoidSilence,
+    loudness,
+    transients
+};
+
+// Levels of a ring buffer in fixed blocks: the peak and RMS of each block and
+// whether it starts a transient. Peaks are kept in a max tree so the loudest
+// sample of any stretch can be looked up without scanning it, and a sum tree
+// of placement weights lets a position be drawn by weight in O(log n).
+class AmplitudeIndex
+{
+public:
+    void prepare(int ringBufferSize);
+    void release();
+
+    // call after writing to the ring buffer, positions wrap around its end,
+    // the ring buffer's channels can hold float or Float16 samples
+    template <typename SampleType>
+    void update(const SampleType* const* ringBuffer, int numChannels, int startSample, int numSamples);
+
+    // peak over all channels, rounded out to whole blocks so it never underestimates
+    float getPeak(int startSample, int numSamples) const;
+
+    // rebuilds the weights when the placement changes
+    void setPlacement(GrainPlacement newPlacement);
+
+    // draws a position in the stretch with a chance proportional to the weight of its block,
+    // randomValue picks the block and randomOffset the position in it, -1 if nothing has any weight
+    int pickPosition(int startSample, int numSamples, float randomValue, float randomOffset) const;
+
+    static juce::StringArray getPlacementNames();
+
+    static constexpr int blockSize = 64;
+
+private:
+    template <typename SampleType>
+    void updateBlocks(const SampleType* const* ringBuffer, int numChannels, int firstBlock, int lastBlock);
+    void rebuildWeights();
+    void updateWeight(int block);
+    float getWeight(int block) const;
+    bool isTransient(int block) const;
+
+    float getPeakOfBlocks(int firstBlock, int lastBlock) const;
+    float getWeightOfBlocks(int firstBlock, int lastBlock) const;
+    int findBlock(float weightBefore) const;
+    int pickPositionInRun(int runStart, int runLength, float weightIntoRun, float randomOffset) const;
+
+    static constexpr int transientHistory = 8;          // blocks the onset is compared against
+    static constexpr float transientRatio = 4.0f;       // energy over the recent average, about 6 dB
+    static constexpr float silenceFloor = 0.001f;       // -60 dB
+
+    int bufferSize = 0;
+    int numBlocks = 0;
+    int numLeaves = 0;
+
+    GrainPlacement placement = GrainPlacement::uniform;
+
+    // node n covers nodes 2n and 2n + 1, blocks are the leaves from numLeaves
+    std::vector<float> peakTree;
+    std::vector<float> weightTree;
+    std::vector<float> energies;    // mean square of each block
+};
@@ -0,0 +1,51 @@
+#include "BackgroundImageLoader.h"
+
+
+BackgroundImageLoader::BackgroundImageLoader() : juce::Thread("Shatter background loader")
+{
+}
+
+BackgroundImageLoader::~BackgroundImageLoader()
+{
+    stopThread(4000);
+}
+
+void BackgroundImageLoader::load(int coveredWidth, int coveredHeight)
+{
+    // already decoded or on its way
+    if (width > 0)
+    {
+        return;
+    }
+    
+    width = coveredWidth;
+    height = coveredHeight;
+    startThread();
+}
+
+juce::Image BackgroundImageLoader::getImage() const
+{
+    const juce::ScopedLock lock(imageLock);
+    return image;
+}
+
+void BackgroundImageLoader::run()
+{
+    auto decodedImage = juce::ImageFileFormat::loadFrom(BinaryData::particles_jpg, BinaryData::particles_jpgSize);
+    
+    if (! decodedImage.isValid() || threadShouldExit())
+    {
+        return;
+    }
+    
+    // never scaled up, the editor stretches it the rest of the way
+    double scale = std::min(1.0, std::max(width / (double) decodedImage.getWidth(), height / (double) decodedImage.getHeight()));
+    auto displayImage = decodedImage.rescaled(juce::roundToInt(decodedImage.getWidth() * scale), juce::roundToInt(decodedImage.getHeight() * scale), juce::Graphics::highResamplingQuality);
+    
+    {
+        const juce::ScopedLock lock(imageLock);
+        image = displayImage;
+    }
+    
+    sendChangeMessage();
+}
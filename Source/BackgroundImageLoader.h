@@ -0,0 +1,30 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Decodes the editor background on a background thread, once for the whole
+// process, and keeps only a copy large enough to cover what is displayed. The
+// processors share it, so it outlives the editors that come and go.
+// Listeners are told on the message thread when the image is ready.
+class BackgroundImageLoader : public juce::ChangeBroadcaster, private juce::Thread
+{
+public:
+    BackgroundImageLoader();
+    ~BackgroundImageLoader() override;
+    
+    // message thread, starts decoding the first time it's called, the image keeps the source's
+    // proportions and is scaled down until it just covers the given size
+    void load(int coveredWidth, int coveredHeight);
+    
+    // invalid until decoding has finished
+    juce::Image getImage() const;
+    
+private:
+    void run() override;
+    
+    int width = 0;
+    int height = 0;
+    
+    juce::CriticalSection imageLock;
+    juce::Image image;
+};
@@ -0,0 +1,91 @@
+#include "BinaryState.h"
+
+namespace BinaryState
+{
+    constexpr size_t headerSize = 2 * sizeof(juce::int32);
+    constexpr size_t chunkHeaderSize = 4 + sizeof(juce::int32);
+
+    bool hasBinaryHeader(const void* data, int sizeInBytes)
+    {
+        return data != nullptr && sizeInBytes >= (int) headerSize
+            && juce::ByteOrder::littleEndianInt(data) == (juce::uint32) magic;
+    }
+
+    Writer::Writer(juce::MemoryBlock& destination) : stream(destination, false)
+    {
+        stream.writeInt(magic);
+        stream.writeInt(currentVersion);
+    }
+
+    juce::OutputStream& Writer::beginChunk(const char* chunkID)
+    {
+        jassert(chunkLengthPosition < 0 && strlen(chunkID) == 4);
+
+        stream.write(chunkID, 4);
+        chunkLengthPosition = stream.getPosition();
+        stream.writeInt(0);
+
+        return stream;
+    }
+
+    void Writer::endChunk()
+    {
+        jassert(chunkLengthPosition >= 0);
+
+        auto endPosition = stream.getPosition();
+        stream.setPosition(chunkLengthPosition);
+        stream.writeInt((int) (endPosition - chunkLengthPosition - (juce::int64) sizeof(juce::int32)));
+        stream.setPosition(endPosition);
+
+        chunkLengthPosition = -1;
+    }
+
+    Reader::Reader(const void* stateData, int sizeInBytes) : data(static_cast<const char*>(stateData)),
+        dataSize((size_t) sizeInBytes), nextChunkPosition(headerSize)
+    {
+        jassert(hasBinaryHeader(stateData, sizeInBytes));
+
+        version = (int) juce::ByteOrder::littleEndianInt(data + sizeof(juce::int32));
+    }
+
+    int Reader::getVersion() const
+    {
+        return version;
+    }
+
+    bool Reader::nextChunk()
+    {
+        chunkStream.reset();
+
+        if (nextChunkPosition + chunkHeaderSize > dataSize)
+        {
+            return false;
+        }
+
+        chunkName = juce::String(data + nextChunkPosition, 4);
+        auto chunkLength = (size_t) juce::ByteOrder::littleEndianInt(data + nextChunkPosition + 4);
+        auto payloadPosition = nextChunkPosition + chunkHeaderSize;
+
+        // a truncated chunk means the rest of the data can't be trusted
+        if (payloadPosition + chunkLength > dataSize)
+        {
+            return false;
+        }
+
+        chunkStream = std::make_unique<juce::MemoryInputStream>(data + payloadPosition, chunkLength, false);
+        nextChunkPosition = payloadPosition + chunkLength;
+
+        return true;
+    }
+
+    bool Reader::isChunk(const char* chunkID) const
+    {
+        return chunkName == chunkID;
+    }
+
+    juce::InputStream& Reader::getChunkStream()
+    {
+        jassert(chunkStream != nullptr);
+        return *chunkStream;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Compact session state: a magic number and a version followed by tagged,
+// length-prefixed chunks. Readers skip chunks they don't recognise, so older
+// builds can still open sessions saved by newer ones.
+namespace BinaryState
+{
+    constexpr int magic = 0x52544853;   // "SHTR"
+    constexpr int currentVersion = 1;
+
+    bool hasBinaryHeader(const void* data, int sizeInBytes);
+
+    class Writer
+    {
+    public:
+        explicit Writer(juce::MemoryBlock& destination);
+
+        // starts a chunk, its length is filled in by endChunk
+        juce::OutputStream& beginChunk(const char* chunkID);
+        void endChunk();
+
+    private:
+        juce::MemoryOutputStream stream;
+        juce::int64 chunkLengthPosition = -1;
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const void* data, int sizeInBytes);
+
+        int getVersion() const;
+
+        // moves to the next chunk, returns false once there are no more
+        bool nextChunk();
+        bool isChunk(const char* chunkID) const;
+        juce::InputStream& getChunkStream();
+
+    private:
+        const char* data;
+        size_t dataSize;
+        size_t nextChunkPosition;
+        int version = 0;
+
+        juce::String chunkName;
+        std::unique_ptr<juce::MemoryInputStream> chunkStream;
+    };
+}
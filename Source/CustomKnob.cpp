@@ -2,13 +2,42 @@
 
 void CustomKnob::drawRotarySlider(juce::Graphics &g, int x, int y, int width, int height, float sliderPos, float rotaryStartAngle, float rotaryEndAngle, juce::Slider &)
 {
-    auto radius = (float) juce::jmin (width / 2, height / 2) - 4.0f;
+    float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    
+    if (width != cachedWidth || height != cachedHeight || scale != cachedScale)
+    {
+        updateCache(width, height, scale);
+    }
+    
     auto centreX = (float) x + (float) width  * 0.5f;
     auto centreY = (float) y + (float) height * 0.5f;
+    auto angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
+    
+    // face and outline
+    g.drawImage(knobFace, juce::Rectangle<float>((float) x, (float) y, (float) width, (float) height));
+    
+    // pointer
+    g.setColour (juce::Colours::darkred);
+    g.fillPath (pointer, juce::AffineTransform::rotation (angle).translated (centreX, centreY));
+}
+
+void CustomKnob::updateCache(int width, int height, float scale)
+{
+    cachedWidth = width;
+    cachedHeight = height;
+    cachedScale = scale;
+    
+    auto radius = (float) juce::jmin (width / 2, height / 2) - 4.0f;
+    auto centreX = (float) width  * 0.5f;
+    auto centreY = (float) height * 0.5f;
     auto rx = centreX - radius;
     auto ry = centreY - radius;
     auto rw = radius * 2.0f;
-    auto angle = rotaryStartAngle + sliderPos * (rotaryEndAngle - rotaryStartAngle);
+    
+    // drawn at the physical pixel size so that it is copied 1:1 to the screen
+    knobFace = juce::Image(juce::Image::ARGB, std::max(1, juce::roundToInt(width * scale)), std::max(1, juce::roundToInt(height * scale)), true);
+    juce::Graphics g(knobFace);
+    g.addTransform(juce::AffineTransform::scale(scale));
     
     // fill
     g.setColour (juce::Colours::snow);
@@ -18,14 +47,9 @@ void CustomKnob::drawRotarySlider(juce::Graphics &g, int x, int y, int width, in
     g.setColour (juce::Colours::darkred);
     g.drawEllipse (rx, ry, rw, rw, 2.0f);
     
-    juce::Path p;
+    // pointer pointing straight up around the origin, rotated into place when drawn
     auto pointerLength = radius * 0.5f;
     auto pointerThickness = 3.0f;
-    p.addRectangle (-pointerThickness * 0.5f, -radius, pointerThickness, pointerLength);
-    p.applyTransform (juce::AffineTransform::rotation (angle).translated (centreX, centreY));
-    
-    // pointer
-    g.setColour (juce::Colours::darkred);
-    g.fillPath (p);
+    pointer.clear();
+    pointer.addRectangle (-pointerThickness * 0.5f, -radius, pointerThickness, pointerLength);
 }
-
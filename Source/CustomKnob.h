@@ -7,5 +7,14 @@ class CustomKnob : public juce::LookAndFeel_V4
 public:
     void drawRotarySlider(juce::Graphics& g, int x, int y, int width, int height, float sliderPos, float rotaryStartAngle, float rotaryEndAngle, juce::Slider&) override;
     
+private:
+    void updateCache(int width, int height, float scale);
     
+    // face and outline never change between frames, only the pointer is drawn each time
+    juce::Image knobFace;
+    juce::Path pointer;
+    
+    int cachedWidth = 0;
+    int cachedHeight = 0;
+    float cachedScale = 0.0f;
 };
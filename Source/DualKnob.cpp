@@ -22,6 +22,31 @@ DualKnob::~DualKnob()
 
 void DualKnob::paint(juce::Graphics& g)
 {
+    float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    
+    if (scale != panelScale || ! panel.isValid())
+    {
+        updatePanelCache(scale);
+    }
+    
+    g.drawImage(panel, getLocalBounds().toFloat());
+}
+
+void DualKnob::updatePanelCache(float scale)
+{
+    panelScale = scale;
+    
+    if (getWidth() <= 0 || getHeight() <= 0)
+    {
+        panel = {};
+        return;
+    }
+    
+    // rendered once per size and scale, paint then just copies it
+    panel = juce::Image(juce::Image::ARGB, juce::roundToInt(getWidth() * scale), juce::roundToInt(getHeight() * scale), true);
+    juce::Graphics g(panel);
+    g.addTransform(juce::AffineTransform::scale(scale));
+    
     g.setColour (juce::Colours::darkslategrey);
     g.setOpacity(0.97);
     g.fillRoundedRectangle(getLocalBounds().reduced(outlineThickness).toFloat(), curveAmount);
@@ -33,6 +58,8 @@ void DualKnob::paint(juce::Graphics& g)
 
 void DualKnob::resized()
 {
+    panel = {};
+    
     int knobSize = getWidth() / 3.5;
     
     firstKnob.setSize(knobSize, knobSize);
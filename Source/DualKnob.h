@@ -19,6 +19,7 @@ public:
     
 private:
     void initKnob(juce::Slider& knob, juce::Label& label, std::string name, double skewFactor, std::string ID);
+    void updatePanelCache(float scale);
     
     CustomKnob knobLookAndFeel;
     
@@ -30,4 +31,7 @@ private:
     
     int outlineThickness;
     int curveAmount;
+    
+    juce::Image panel;
+    float panelScale = 0.0f;
 };
@@ -0,0 +1,156 @@
+#pragma once
+#include <JuceHeader.h>
+
+// AVX2 doesn't imply F16C, so only the F16C flag itself turns the conversion instructions on
+#if defined(__F16C__)
+ #include <immintrin.h>
+ #define SHATTER_USE_F16C 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+ #include <arm_neon.h>
+ #define SHATTER_USE_NEON_FP16 1
+#endif
+
+// IEEE half precision sample, used to store the delay buffer in half the memory.
+// Conversions round to nearest even and saturate at the largest finite half
+// instead of overflowing to infinity.
+struct Float16
+{
+    juce::uint16 bits;
+
+    static Float16 fromFloat(float value)
+    {
+        juce::uint32 floatBits;
+        std::memcpy(&floatBits, &value, sizeof(floatBits));
+
+        juce::uint32 sign = (floatBits >> 16) & 0x8000;
+        juce::uint32 magnitude = floatBits & 0x7fffffff;
+
+        // past 65504, and nan
+        if (magnitude > 0x477fe000)
+        {
+            return { (juce::uint16) (sign | 0x7bff) };
+        }
+
+        // below the smallest normal half the value is stored as a multiple of 2^-24
+        if (magnitude < 0x38800000)
+        {
+            if (magnitude < 0x33000000)
+            {
+                return { (juce::uint16) sign };
+            }
+
+            int shift = 126 - (int) (magnitude >> 23);
+            juce::uint32 mantissa = (magnitude & 0x7fffff) | 0x800000;
+            juce::uint32 half = mantissa >> shift;
+            juce::uint32 remainder = mantissa & ((1u << shift) - 1);
+            juce::uint32 halfway = 1u << (shift - 1);
+
+            if (remainder > halfway || (remainder == halfway && (half & 1)))
+            {
+                ++half;
+            }
+
+            return { (juce::uint16) (sign | half) };
+        }
+
+        // rebias the exponent and drop 13 bits of mantissa, a carry out of the mantissa correctly bumps the exponent
+        juce::uint32 half = (magnitude - 0x38000000) >> 13;
+        juce::uint32 remainder = magnitude & 0x1fff;
+
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        {
+            ++half;
+        }
+
+        return { (juce::uint16) (sign | half) };
+    }
+
+    float toFloat() const
+    {
+        juce::uint32 sign = (juce::uint32) (bits & 0x8000) << 16;
+        juce::uint32 exponent = (bits >> 10) & 0x1f;
+        juce::uint32 mantissa = bits & 0x3ff;
+        juce::uint32 floatBits;
+
+        if (exponent == 0)
+        {
+            float value = (float) mantissa * 5.9604644775390625e-8f;    // 2^-24
+            return sign != 0 ? -value : value;
+        }
+
+        if (exponent == 31)
+        {
+            floatBits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else
+        {
+            floatBits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+
+        float value;
+        std::memcpy(&value, &floatBits, sizeof(value));
+        return value;
+    }
+
+    // numSamples of source narrowed into destination
+    static void convert(Float16* destination, const float* source, int numSamples)
+    {
+        int i = 0;
+
+       #if SHATTER_USE_F16C
+        for (; i + 8 <= numSamples; i += 8)
+        {
+            __m256 clamped = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(source + i), _mm256_set1_ps(-65504.0f)), _mm256_set1_ps(65504.0f));
+            __m128i half = _mm256_cvtps_ph(clamped, _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), half);
+        }
+       #elif SHATTER_USE_NEON_FP16
+        for (; i + 4 <= numSamples; i += 4)
+        {
+            float32x4_t clamped = vminq_f32(vmaxq_f32(vld1q_f32(source + i), vdupq_n_f32(-65504.0f)), vdupq_n_f32(65504.0f));
+            float16x4_t half = vcvt_f16_f32(clamped);
+            vst1_u16(reinterpret_cast<uint16_t*>(destination + i), vreinterpret_u16_f16(half));
+        }
+       #endif
+
+        for (; i < numSamples; ++i)
+        {
+            destination[i] = fromFloat(source[i]);
+        }
+    }
+
+    // four consecutive samples from source widened into destination, in reverse when sourceStride is -1
+    template <int sourceStride>
+    static void loadFour(const Float16* source, float* destination)
+    {
+        const Float16* first = sourceStride > 0 ? source : source - 3;
+
+       #if SHATTER_USE_F16C
+        __m128 values = _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(first)));
+        if (sourceStride < 0)
+        {
+            values = _mm_shuffle_ps(values, values, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        _mm_storeu_ps(destination, values);
+       #elif SHATTER_USE_NEON_FP16
+        float32x4_t values = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t*>(first))));
+        if (sourceStride < 0)
+        {
+            values = vcombine_f32(vrev64_f32(vget_high_f32(values)), vrev64_f32(vget_low_f32(values)));
+        }
+        vst1q_f32(destination, values);
+       #else
+        juce::ignoreUnused(first);
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            destination[lane] = source[lane * sourceStride].toFloat();
+        }
+       #endif
+    }
+};
+
+static_assert(sizeof(Float16) == 2, "Float16 has to pack into two bytes");
+
+// lets code that reads the delay buffer be written once for either storage
+inline float toFloat(float sample)      { return sample; }
+inline float toFloat(Float16 sample)    { return sample.toFloat(); }
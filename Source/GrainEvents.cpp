@@ -0,0 +1,27 @@
+#include "GrainEvents.h"
+
+bool GrainEventFifo::push(const GrainEvent& event)
+{
+    if (event.type == GrainEvent::Type::progressed && fifo.getFreeSpace() < capacity / 4)
+    {
+        return false;
+    }
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+    {
+        return false;
+    }
+
+    events[(size_t) start1] = event;
+    fifo.finishedWrite(1);
+
+    return true;
+}
+
+void GrainEventFifo::discardAll()
+{
+    fifo.finishedRead(fifo.getNumReady());
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <JuceHeader.h>
+
+// What the engine reports to the editor. Positions and sizes are fractions
+// of the delay buffer so the editor doesn't need to know its length.
+struct GrainEvent
+{
+    enum class Type : juce::uint8
+    {
+        spawned,
+        progressed,
+        finished,
+        waveform    // id is the waveform column, position its peak level
+    };
+
+    Type type;
+    int id;
+    float position;
+    float size;
+    float pan;
+    float phase;    // how far through its envelope the grain is
+};
+
+// Wait-free single producer, single consumer queue from the audio thread to
+// the editor. When the editor isn't draining it, pushes fail and events are dropped.
+// The last quarter is kept for everything but progressed events, so a dense cloud
+// can't crowd out the spawns and finishes the editor needs to keep track of grains.
+class GrainEventFifo
+{
+public:
+    bool push(const GrainEvent& event);
+
+    // consumer side, throws away whatever was queued while nobody was reading
+    void discardAll();
+
+    template <typename Callback>
+    void popAll(Callback&& callback)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)     { callback(events[(size_t) (start1 + i)]); }
+        for (int i = 0; i < size2; ++i)     { callback(events[(size_t) (start2 + i)]); }
+
+        fifo.finishedRead(size1 + size2);
+    }
+
+    static constexpr int capacity = 8192;
+    static constexpr int progressRate = 30;     // progressed events per second for each grain, one per editor frame
+
+private:
+    juce::AbstractFifo fifo { capacity };
+    std::array<GrainEvent, capacity> events;
+};
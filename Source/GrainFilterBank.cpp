@@ -0,0 +1,226 @@
+#include "GrainFilterBank.h"
+
+void GrainFilterBank::prepare(int numSlots)
+{
+    for (auto* values : { &a1, &a2, &a3, &inputMix, &bandMix, &lowMix })
+    {
+        values->assign((size_t) numSlots, 0.0f);
+    }
+
+    tailSamplesLeft.assign((size_t) numSlots, 0);
+
+    for (int channel = 0; channel < maxChannels; ++channel)
+    {
+        state1[channel].assign((size_t) numSlots, 0.0f);
+        state2[channel].assign((size_t) numSlots, 0.0f);
+    }
+
+    freeSlots.reserve((size_t) numSlots);
+    ringingSlots.reserve((size_t) numSlots);
+    clear();
+}
+
+void GrainFilterBank::release()
+{
+    for (auto* values : { &a1, &a2, &a3, &inputMix, &bandMix, &lowMix })
+    {
+        std::vector<float>().swap(*values);
+    }
+
+    for (int channel = 0; channel < maxChannels; ++channel)
+    {
+        std::vector<float>().swap(state1[channel]);
+        std::vector<float>().swap(state2[channel]);
+    }
+
+    std::vector<int>().swap(freeSlots);
+    std::vector<int>().swap(ringingSlots);
+    std::vector<int>().swap(tailSamplesLeft);
+}
+
+void GrainFilterBank::clear()
+{
+    freeSlots.clear();
+    ringingSlots.clear();
+
+    // handed out from the back, so the lowest slots go first
+    for (int slot = (int) a1.size() - 1; slot >= 0; --slot)
+    {
+        freeSlots.push_back(slot);
+    }
+}
+
+int GrainFilterBank::add(GrainFilterMode mode, double cutoff, double resonance, double sampleRate)
+{
+    if (mode == GrainFilterMode::off)
+    {
+        return -1;
+    }
+
+    // the tail closest to being done is the one that's cut
+    if (freeSlots.empty() && ! ringingSlots.empty())
+    {
+        auto shortest = std::min_element(ringingSlots.begin(), ringingSlots.end(), [this] (int first, int second)
+        {
+            return tailSamplesLeft[(size_t) first] < tailSamplesLeft[(size_t) second];
+        });
+
+        freeSlots.push_back(*shortest);
+        *shortest = ringingSlots.back();
+        ringingSlots.pop_back();
+    }
+
+    if (freeSlots.empty())
+    {
+        return -1;
+    }
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+    auto index = (size_t) slot;
+
+    double g = std::tan(juce::MathConstants<double>::pi * cutoff / sampleRate);
+    double k = 1.0 / resonance;
+    double coefficient1 = 1.0 / (1.0 + g * (g + k));
+
+    a1[index] = (float) coefficient1;
+    a2[index] = (float) (g * coefficient1);
+    a3[index] = (float) (g * g * coefficient1);
+
+    // k times the band pass peaks at unity whatever the resonance
+    inputMix[index] = mode == GrainFilterMode::highPass ? 1.0f : 0.0f;
+    bandMix[index] = mode == GrainFilterMode::bandPass ? (float) k : (mode == GrainFilterMode::highPass ? (float) -k : 0.0f);
+    lowMix[index] = mode == GrainFilterMode::lowPass ? 1.0f : (mode == GrainFilterMode::highPass ? -1.0f : 0.0f);
+
+    for (int channel = 0; channel < maxChannels; ++channel)
+    {
+        state1[channel][index] = 0.0f;
+        state2[channel][index] = 0.0f;
+    }
+
+    tailSamplesLeft[index] = (int) (maxTailSeconds * sampleRate);
+
+    return slot;
+}
+
+void GrainFilterBank::remove(int slot)
+{
+    if (slot >= 0)
+    {
+        ringingSlots.push_back(slot);
+    }
+}
+
+void GrainFilterBank::process(const int* slots, int numLanes, const float* const* inputs, float* destination, int channel, int numSamples)
+{
+    processLanes<true>(slots, numLanes, inputs, destination, channel, numSamples);
+}
+
+void GrainFilterBank::processTails(float* const* destination, int numChannels, int numSamples)
+{
+    for (size_t first = 0; first < ringingSlots.size(); first += laneCount)
+    {
+        int numLanes = std::min(laneCount, (int) (ringingSlots.size() - first));
+
+        for (int channel = 0; channel < std::min(numChannels, maxChannels); ++channel)
+        {
+            processLanes<false>(ringingSlots.data() + first, numLanes, nullptr, destination[channel], channel, numSamples);
+        }
+    }
+
+    size_t i = 0;
+
+    while (i < ringingSlots.size())
+    {
+        auto index = (size_t) ringingSlots[i];
+        tailSamplesLeft[index] -= numSamples;
+
+        if (tailSamplesLeft[index] > 0 && ! hasDecayed(index))
+        {
+            ++i;
+            continue;
+        }
+
+        freeSlots.push_back(ringingSlots[i]);
+        ringingSlots[i] = ringingSlots.back();
+        ringingSlots.pop_back();
+    }
+}
+
+bool GrainFilterBank::hasDecayed(size_t index) const
+{
+    for (int channel = 0; channel < maxChannels; ++channel)
+    {
+        if (std::abs(state1[channel][index]) >= tailThreshold || std::abs(state2[channel][index]) >= tailThreshold)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// without an input the lanes ring on silence, which is how a slot's tail is played out
+template <bool hasInput>
+void GrainFilterBank::processLanes(const int* slots, int numLanes, const float* const* inputs, float* destination, int channel, int numSamples)
+{
+    // lanes without a grain keep zero coefficients and state, so they add nothing
+    float c1[laneCount] = {};
+    float c2[laneCount] = {};
+    float c3[laneCount] = {};
+    float m0[laneCount] = {};
+    float m1[laneCount] = {};
+    float m2[laneCount] = {};
+    float s1[laneCount] = {};
+    float s2[laneCount] = {};
+
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        auto index = (size_t) slots[lane];
+        c1[lane] = a1[index];
+        c2[lane] = a2[index];
+        c3[lane] = a3[index];
+        m0[lane] = inputMix[index];
+        m1[lane] = bandMix[index];
+        m2[lane] = lowMix[index];
+        s1[lane] = state1[channel][index];
+        s2[lane] = state2[channel][index];
+    }
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float output[laneCount];
+
+        for (int lane = 0; lane < laneCount; ++lane)
+        {
+            float v0 = hasInput ? inputs[lane][i] : 0.0f;
+            float v3 = v0 - s2[lane];
+            float v1 = c1[lane] * s1[lane] + c2[lane] * v3;
+            float v2 = s2[lane] + c2[lane] * s1[lane] + c3[lane] * v3;
+            s1[lane] = 2.0f * v1 - s1[lane];
+            s2[lane] = 2.0f * v2 - s2[lane];
+            output[lane] = m0[lane] * v0 + m1[lane] * v1 + m2[lane] * v2;
+        }
+
+        float sum = 0.0f;
+        for (int lane = 0; lane < laneCount; ++lane)
+        {
+            sum += output[lane];
+        }
+
+        destination[i] += sum;
+    }
+
+    // a grain's tail would otherwise decay into denormals
+    for (int lane = 0; lane < numLanes; ++lane)
+    {
+        auto index = (size_t) slots[lane];
+        state1[channel][index] = std::abs(s1[lane]) < 1.0e-15f ? 0.0f : s1[lane];
+        state2[channel][index] = std::abs(s2[lane]) < 1.0e-15f ? 0.0f : s2[lane];
+    }
+}
+
+juce::StringArray GrainFilterBank::getModeNames()
+{
+    return { "Off", "Low Pass", "Band Pass", "High Pass" };
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <JuceHeader.h>
+
+enum class GrainFilterMode
+{
+    off = 0,
+    lowPass,
+    bandPass,
+    highPass
+};
+
+// A resonant state-variable filter for every grain that spawns with one. Coefficients and state
+// are parallel arrays indexed by slot instead of a filter object per grain, and grains are filtered
+// laneCount at a time with one grain per lane, so each sample's update runs across the grains
+// together and the compiler can keep the lanes in one SIMD register. A slot
+// outlives its grain, ringing on silence until the filter has decayed.
+class GrainFilterBank
+{
+public:
+    void prepare(int numSlots);
+    void release();
+    void clear();
+
+    // the slot to filter a new grain with, -1 when every slot is taken, a slot still ringing is cut short rather than
+    // turning the grain away
+    int add(GrainFilterMode mode, double cutoff, double resonance, double sampleRate);
+
+    // the grain is done with the slot, which keeps ringing through processTails until it has decayed below
+    // tailThreshold or rung for maxTailSeconds, and only then is handed out again
+    void remove(int slot);
+
+    // filters one channel of up to laneCount grains and adds them all into destination,
+    // inputs always has laneCount channels and the ones past numLanes are ignored
+    void process(const int* slots, int numLanes, const float* const* inputs, float* destination, int channel, int numSamples);
+
+    // adds the tails of every removed slot still ringing into destination, once per block
+    void processTails(float* const* destination, int numChannels, int numSamples);
+
+    static juce::StringArray getModeNames();
+
+    static constexpr int laneCount = 4;     // four floats to a register, like GrainWindow
+    static constexpr int maxChannels = 2;
+    static constexpr float tailThreshold = 1.0e-5f;     // -100 dB
+    static constexpr double maxTailSeconds = 1.0;
+
+private:
+    template <bool hasInput>
+    void processLanes(const int* slots, int numLanes, const float* const* inputs, float* destination, int channel, int numSamples);
+
+    bool hasDecayed(size_t index) const;
+
+    // Simper's trapezoidal SVF, the output is a mix of the input, band pass and low pass
+    std::vector<float> a1, a2, a3;
+    std::vector<float> inputMix, bandMix, lowMix;
+    std::vector<float> state1[maxChannels];
+    std::vector<float> state2[maxChannels];
+
+    std::vector<int> freeSlots;
+    std::vector<int> ringingSlots;
+    std::vector<int> tailSamplesLeft;
+};
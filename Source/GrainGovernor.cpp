@@ -0,0 +1,153 @@
+#include "GrainGovernor.h"
+
+void GrainGovernor::prepare(double sr)
+{
+    sampleRate = sr;
+    smoothedLoad = 0.0f;
+    blocksSinceChange = 0;
+
+    grainLimit = 0;
+    sizeScale = 1.0f;
+    spawnProbability = 1.0f;
+
+    stageTicks.fill(0);
+    smoothedStageCost.fill(0.0f);
+
+    publishMetrics(0);
+}
+
+void GrainGovernor::setMaximumLoad(float share)     { maximumLoad = juce::jlimit(0.05f, 1.0f, share); }
+float GrainGovernor::getMaximumLoad() const         { return maximumLoad; }
+
+void GrainGovernor::beginBlock()
+{
+    blockStartTicks = juce::Time::getHighResolutionTicks();
+    lastMarkTicks = blockStartTicks;
+}
+
+void GrainGovernor::markStage(Stage stage)
+{
+    auto ticks = juce::Time::getHighResolutionTicks();
+    stageTicks[(size_t) stage] += ticks - lastMarkTicks;
+    lastMarkTicks = ticks;
+}
+
+void GrainGovernor::endBlock(int numSamples, int numActiveGrains)
+{
+    if (numSamples <= 0)
+    {
+        return;
+    }
+
+    double renderSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - blockStartTicks);
+    float load = (float) (renderSeconds * sampleRate / numSamples);
+
+    // rise quickly so a spike is acted on, fall slowly so one quiet block doesn't undo it
+    float smoothing = load > smoothedLoad ? 0.5f : 0.05f;
+    smoothedLoad += smoothing * (load - smoothedLoad);
+
+    // the stages only inform, so they are all smoothed evenly
+    for (size_t stage = 0; stage < (size_t) numStages; ++stage)
+    {
+        float cost = (float) (juce::Time::highResolutionTicksToSeconds(stageTicks[stage]) * 1.0e9 / numSamples);
+        smoothedStageCost[stage] += 0.05f * (cost - smoothedStageCost[stage]);
+        stageTicks[stage] = 0;
+    }
+
+    ++blocksSinceChange;
+    float limit = maximumLoad;
+
+    if (smoothedLoad > limit && blocksSinceChange >= blocksBetweenIncreases)
+    {
+        increasePressure(numActiveGrains);
+    }
+    else if (smoothedLoad < limit * recoveryThreshold && isLimiting() && blocksSinceChange >= blocksBetweenDecreases)
+    {
+        decreasePressure();
+    }
+
+    publishMetrics(numActiveGrains);
+}
+
+bool GrainGovernor::shouldSpawn(int numActiveGrains, float randomValue)
+{
+    if ((grainLimit > 0 && numActiveGrains >= grainLimit) || randomValue >= spawnProbability)
+    {
+        ++skippedSpawns;
+        return false;
+    }
+
+    return true;
+}
+
+double GrainGovernor::getSizeScale() const                          { return sizeScale; }
+const GrainGovernor::Metrics& GrainGovernor::getMetrics() const     { return metrics; }
+
+bool GrainGovernor::isLimiting() const
+{
+    return grainLimit > 0 || sizeScale < 1.0f || spawnProbability < 1.0f;
+}
+
+juce::StringArray GrainGovernor::getStageNames()
+{
+    return { "Write", "Spawn", "Grains", "Output" };
+}
+
+void GrainGovernor::increasePressure(int numActiveGrains)
+{
+    blocksSinceChange = 0;
+
+    // cap once below what is playing now, then shorten new grains, then spawn fewer of them, the count
+    // can't rise past a cap, so capping again below it would ratchet down to the minimum before anything else
+    if (grainLimit == 0)
+    {
+        grainLimit = std::max(minimumGrainLimit, (int) (numActiveGrains * 0.8f));
+    }
+    else if (sizeScale > minimumSizeScale)
+    {
+        sizeScale = std::max(minimumSizeScale, sizeScale * 0.9f);
+    }
+    else
+    {
+        spawnProbability = std::max(minimumSpawnProbability, spawnProbability * 0.9f);
+    }
+}
+
+void GrainGovernor::decreasePressure()
+{
+    blocksSinceChange = 0;
+
+    if (spawnProbability < 1.0f)
+    {
+        spawnProbability = std::min(1.0f, spawnProbability / 0.9f);
+    }
+    else if (sizeScale < 1.0f)
+    {
+        sizeScale = std::min(1.0f, sizeScale / 0.9f);
+    }
+    else
+    {
+        // lifted entirely once it has grown well past what was being capped
+        grainLimit = grainLimit + std::max(1, grainLimit / 10);
+
+        if (grainLimit > 4 * minimumGrainLimit && metrics.activeGrains < grainLimit / 2)
+        {
+            grainLimit = 0;
+        }
+    }
+}
+
+void GrainGovernor::publishMetrics(int numActiveGrains)
+{
+    metrics.load = smoothedLoad;
+    metrics.activeGrains = numActiveGrains;
+    metrics.grainLimit = grainLimit;
+    metrics.sizeScale = sizeScale;
+    metrics.spawnProbability = spawnProbability;
+    metrics.skippedSpawns = skippedSpawns;
+
+    for (size_t stage = 0; stage < (size_t) numStages; ++stage)
+    {
+        metrics.stageCost[stage] = smoothedStageCost[stage];
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Keeps the grain engine inside a share of the audio callback. Render time is
+// measured every block and, under pressure, the governor first caps the number
+// of active grains once, then shortens new grains and finally thins out spawns.
+// It backs off in the reverse order once the load has stayed low for a while.
+class GrainGovernor
+{
+public:
+    // the parts of a block the engine renders, in order
+    enum class Stage
+    {
+        write = 0,
+        spawn,
+        read,
+        output
+    };
+
+    static constexpr int numStages = 4;
+
+    struct Metrics
+    {
+        std::atomic<float> load { 0.0f };                // smoothed render time over the block's duration
+        std::atomic<int> activeGrains { 0 };
+        std::atomic<int> grainLimit { 0 };               // 0 when unlimited
+        std::atomic<float> sizeScale { 1.0f };
+        std::atomic<float> spawnProbability { 1.0f };
+        std::atomic<int> skippedSpawns { 0 };
+        std::array<std::atomic<float>, numStages> stageCost {};    // smoothed nanoseconds per sample spent in each stage
+    };
+
+    void prepare(double sampleRate);
+
+    void setMaximumLoad(float share);
+    float getMaximumLoad() const;
+
+    // audio thread, around each block the engine renders
+    void beginBlock();
+    void endBlock(int numSamples, int numActiveGrains);
+
+    // audio thread, when a stage has finished, it's timed from the previous mark or the start of the block
+    void markStage(Stage stage);
+
+    // audio thread, consulted when spawning a grain
+    bool shouldSpawn(int numActiveGrains, float randomValue);
+    double getSizeScale() const;
+
+    const Metrics& getMetrics() const;
+    bool isLimiting() const;
+
+    static juce::StringArray getStageNames();
+
+private:
+    void increasePressure(int numActiveGrains);
+    void decreasePressure();
+    void publishMetrics(int numActiveGrains);
+
+    static constexpr int minimumGrainLimit = 4;
+    static constexpr int blocksBetweenIncreases = 4;
+    static constexpr int blocksBetweenDecreases = 32;
+    static constexpr float recoveryThreshold = 0.7f;    // of the maximum load
+    static constexpr float minimumSizeScale = 0.5f;
+    static constexpr float minimumSpawnProbability = 0.25f;
+
+    double sampleRate = 44100.0;
+    std::atomic<float> maximumLoad { 0.5f };
+
+    juce::int64 blockStartTicks = 0;
+    juce::int64 lastMarkTicks = 0;
+    std::array<juce::int64, numStages> stageTicks {};
+    std::array<float, numStages> smoothedStageCost {};
+    float smoothedLoad = 0.0f;
+    int blocksSinceChange = 0;
+
+    int grainLimit = 0;
+    float sizeScale = 1.0f;
+    float spawnProbability = 1.0f;
+    int skippedSpawns = 0;
+
+    Metrics metrics;
+};
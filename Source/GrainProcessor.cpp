@@ -1,66 +1,283 @@
 #include "GrainProcessor.h"
 
+namespace
+{
+    constexpr float feedbackDCCoefficient = 0.995f;    // one pole high pass at about 35 Hz at 44.1k
+
+    // feedback[i], soft clipped by a rational tanh that flattens out at +-1, scaled by a ramped gain and added to input[i]
+    void addSaturatedFeedback(float* destination, const float* input, const float* feedback, float startGain, float gainIncrement, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float x = std::min(3.0f, std::max(-3.0f, feedback[i]));
+            float saturated = x * (27.0f + x * x) / (27.0f + 9.0f * x * x);
+            
+            destination[i] = input[i] + (startGain + gainIncrement * i) * saturated;
+        }
+    }
+}
+
 
 GrainProcessor::GrainProcessor()
 {
     delayBufferWriteIndex = 0;
     delayBufferNumChannels = 2;
-    delayBufferSize = 196000;
-    delayBuffer = std::make_unique<juce::AudioBuffer<float>>(delayBufferNumChannels, delayBufferSize);
-    delayBuffer->clear();
+    sampleRate = 44100.0;
+    delayBufferSize = (int) (delayBufferSeconds * sampleRate);
+    delayBuffer = std::make_unique<juce::AudioBuffer<float>>();
+    
+    delayStorage = DelayStorage::float32;
+    halfDelayChannels[0] = halfDelayChannels[1] = nullptr;
+    longHistoryLength = 0.0;
+    isPrepared = false;
+    
+    numWetSamples = 0;
+    feedbackAmount = 0.0;
+    grainAge = 0.0;
+    dryWetMix = 1.0;
+    outputGain = 1.0;
+    dryGain.setCurrentAndTargetValue(0.0f);
+    wetGain.setCurrentAndTargetValue(1.0f);
+    appliedFeedback = 0.0f;
     
     samplesToNextGrain = 0;
+    nextGrainID = 0;
+    waveformPeak = 0.0f;
+    samplesSinceProgressEvents = 0;
     
+    windowShape = WindowShape::hann;
+    windowSkew = 0.5;
+    grainPlacement = GrainPlacement::uniform;
+    zeroSnap = false;
+    microMode = false;
+    microGrainSize = 0.01;
+    microGrainRate = 500.0;
+    samplesToNextMicroGrain = 0.0;
+    filterMode = GrainFilterMode::off;
+    filterCutoff = 2000.0;
+    filterResonance = 0.707;
+    filterSpread = 0.0;
+    reverseProbability = 0.0;
+}
+
+GrainProcessor::~GrainProcessor()
+{
+    release();
 }
 
 void GrainProcessor::grainify(juce::AudioBuffer<float>& audioBuffer)
 {    
+    jassert(isPrepared);
+    
+    if (! isPrepared)
+    {
+        return;
+    }
+    
+    // a host going past the block size it promised gets it processed in pieces instead of a reallocation here,
+    // the pieces refer to the host's channels so they don't allocate either
+    int maximumBlockSize = wetBuffer.getNumSamples();
+    
+    if (audioBuffer.getNumSamples() > maximumBlockSize)
+    {
+        for (int start = 0; start < audioBuffer.getNumSamples(); start += maximumBlockSize)
+        {
+            juce::AudioBuffer<float> piece(audioBuffer.getArrayOfWritePointers(), audioBuffer.getNumChannels(), start,
+                                           std::min(maximumBlockSize, audioBuffer.getNumSamples() - start));
+            grainify(piece);
+        }
+        
+        return;
+    }
+    
+    SHATTER_TRACE_SCOPE("grainify");
+    governor.beginBlock();
+    
     writeToDelayBuffer(audioBuffer);
-    spawnGrains(audioBuffer);
+    governor.markStage(GrainGovernor::Stage::write);
+    if (microMode)
+    {
+        spawnMicroGrains(audioBuffer);
+    }
+    else
+    {
+        spawnGrains(audioBuffer);
+    }
+    governor.markStage(GrainGovernor::Stage::spawn);
     readFromGrains(audioBuffer);
+    governor.markStage(GrainGovernor::Stage::read);
+    mixToOutput(audioBuffer);
+    governor.markStage(GrainGovernor::Stage::output);
+
+    delayBufferWriteIndex = (delayBufferWriteIndex + audioBuffer.getNumSamples()) % delayBufferSize;
+    
+    governor.endBlock(audioBuffer.getNumSamples(), (int) grains.size() + microGrains.getNumActive());
+}
 
+void GrainProcessor::writeBlock(juce::AudioBuffer<float>& audioBuffer)
+{
+    jassert(isPrepared && audioBuffer.getNumSamples() <= wetBuffer.getNumSamples());
+    
+    writeToDelayBuffer(audioBuffer);
     delayBufferWriteIndex = (delayBufferWriteIndex + audioBuffer.getNumSamples()) % delayBufferSize;
 }
 
+int GrainProcessor::mixGrain(juce::AudioBuffer<float>& audioBuffer, Grain& grain, float* const* destination)
+{
+    jassert(isPrepared && ! grain.isFromHistory);
+    
+    int numSamplesRead = mixFromBufferWithWraparound(audioBuffer, grain, destination);
+    updateGrain(grain, numSamplesRead);
+    
+    return numSamplesRead;
+}
+
 void GrainProcessor::writeToDelayBuffer(juce::AudioBuffer<float>& audioBuffer)
 {
+    SHATTER_TRACE_SCOPE("writeToDelayBuffer");
     int bufferSize = audioBuffer.getNumSamples();
+    int samplesRemaining = std::min(bufferSize, delayBufferSize - delayBufferWriteIndex);
     
-    for (int channel = 0; channel < audioBuffer.getNumChannels(); channel++)
+    // the gain ramps across the block so moving the feedback doesn't click
+    float startGain = appliedFeedback;
+    float gainIncrement = ((float) feedbackAmount - startGain) / bufferSize;
+    appliedFeedback = (float) feedbackAmount;
+    
+    // the loop starts from silence each time feedback is turned up from zero
+    if (startGain == 0.0f)
     {
-        if (delayBufferWriteIndex + bufferSize < delayBufferSize)
+        for (auto& filter : feedbackFilters)
         {
-            delayBuffer->copyFrom(channel, delayBufferWriteIndex, audioBuffer, channel, 0, bufferSize);
+            filter = {};
         }
-        else
+    }
+    
+    bool hasFeedback = startGain != 0.0f || appliedFeedback != 0.0f;
+    int numChannels = std::min(audioBuffer.getNumChannels(), delayBufferNumChannels);
+    
+    for (int channel = 0; channel < numChannels; channel++)
+    {
+        const float* input = audioBuffer.getReadPointer(channel);
+        const float* feedback = wetBuffer.getReadPointer(channel);
+        
+        // last block's grains are mixed in as the input is written, one block of loop delay
+        if (hasFeedback)
+        {
+            blockFeedbackDC(channel, bufferSize);
+        }
+        
+        if (delayStorage == DelayStorage::float16)
         {
-            int samplesRemaining = delayBufferSize - delayBufferWriteIndex;
+            if (hasFeedback)
+            {
+                float* block = halfWriteBuffer.getWritePointer(channel);
+                addSaturatedFeedback(block, input, feedback, startGain, gainIncrement, bufferSize);
+                input = block;
+            }
             
+            Float16::convert(halfDelayChannels[channel] + delayBufferWriteIndex, input, samplesRemaining);
+            Float16::convert(halfDelayChannels[channel], input + samplesRemaining, bufferSize - samplesRemaining);
+        }
+        else if (hasFeedback)
+        {
+            addSaturatedFeedback(delayBuffer->getWritePointer(channel, delayBufferWriteIndex), input, feedback, startGain, gainIncrement, samplesRemaining);
+            addSaturatedFeedback(delayBuffer->getWritePointer(channel), input + samplesRemaining, feedback + samplesRemaining,
+                                 startGain + gainIncrement * samplesRemaining, gainIncrement, bufferSize - samplesRemaining);
+        }
+        else
+        {
             delayBuffer->copyFrom(channel, delayBufferWriteIndex, audioBuffer, channel, 0, samplesRemaining);
             delayBuffer->copyFrom(channel, 0, audioBuffer, channel, samplesRemaining, bufferSize - samplesRemaining);
         }
     }
+    
+    if (delayStorage == DelayStorage::float16)
+    {
+        amplitudeIndex.update(halfDelayChannels, delayBufferNumChannels, delayBufferWriteIndex, bufferSize);
+        zeroCrossings.update(halfDelayChannels, delayBufferNumChannels, delayBufferWriteIndex, bufferSize);
+    }
+    else
+    {
+        amplitudeIndex.update(delayBuffer->getArrayOfReadPointers(), delayBufferNumChannels, delayBufferWriteIndex, bufferSize);
+        zeroCrossings.update(delayBuffer->getArrayOfReadPointers(), delayBufferNumChannels, delayBufferWriteIndex, bufferSize);
+    }
+    
+    if (history != nullptr)
+    {
+        history->push(audioBuffer.getArrayOfReadPointers(), numChannels, bufferSize);
+    }
+    
+    pushWaveformEvents(bufferSize);
+}
+
+void GrainProcessor::blockFeedbackDC(int channel, int numSamples)
+{
+    // in place over last block's grains, anything past them is silence
+    float* feedback = wetBuffer.getWritePointer(channel);
+    auto& filter = feedbackFilters[channel];
+    
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float sample = i < numWetSamples ? feedback[i] : 0.0f;
+        float blocked = sample - filter.lastInput + feedbackDCCoefficient * filter.lastOutput;
+        
+        filter.lastInput = sample;
+        filter.lastOutput = blocked;
+        feedback[i] = blocked;
+    }
+    
+    // once the loop dies away the filter would decay into denormals
+    if (std::abs(filter.lastOutput) < 1.0e-15f)
+    {
+        filter.lastOutput = 0.0f;
+    }
 }
 
 void GrainProcessor::spawnGrains(juce::AudioBuffer<float>& audioBuffer)
 {
+    SHATTER_TRACE_SCOPE("spawnGrains");
     int bufferSize = audioBuffer.getNumSamples();
     int bufferIndex = 0;
+    
+    // the history file has already been handed this block
+    juce::int64 blockStartFrame = history != nullptr ? history->getNumFramesPushed() - bufferSize : 0;
 
     while (bufferSize > bufferIndex + samplesToNextGrain)
     {
         bufferIndex += samplesToNextGrain;
         
-        double randomDelay = randomizer.nextDouble() * grainSpread;
-        int startPosition = (delayBufferWriteIndex + bufferIndex) - (int)(randomDelay * sampleRate);
-        if (startPosition < 0)  { startPosition += delayBufferSize; }
-        startPosition %= delayBufferSize;
-    
         double pan = grainWidth == 0 ? 0 : (randomizer.nextDouble() * 2 - 1) * grainWidth;
+        bool isReversed = randomizer.nextDouble() < reverseProbability;
         int size = (int) (std::max(0.1, std::min(1.0, globalGrainSize + (randomizer.nextDouble() - 0.5) * grainSizeRandom)) * sampleRate);  // grain size in terms of samples
+        size = (int) (size * governor.getSizeScale());
         
-        Grain newGrain(size, pan, startPosition, bufferIndex);
-        grains.push_back(newGrain);
+        // older than delayBuffer can hold comes from the history file, or as old as delayBuffer allows without one
+        int ageSamples = (int) (grainAge * sampleRate);
+        int startPosition = -1;
+        juce::int64 prefetchTicket = -1;
+        
+        if (ageSamples > getMaximumBufferAge(size, isReversed) && history != nullptr)
+        {
+            startPosition = getHistoryStartPosition(blockStartFrame + bufferIndex, ageSamples, size, isReversed, prefetchTicket);
+        }
+        
+        bool isFromHistory = startPosition >= 0;
+        
+        if (! isFromHistory)
+        {
+            startPosition = getBufferStartPosition(bufferIndex, size, isReversed);
+        }
+        
+        // the schedule keeps running when a spawn is skipped so the rhythm of the cloud doesn't change
+        if ((int) grains.size() < maxGrains && governor.shouldSpawn((int) grains.size(), randomizer.nextFloat()))
+        {
+            Grain newGrain(nextGrainID++, size, pan, isReversed, isFromHistory, startPosition, bufferIndex, GrainWindow(windowShape, windowSkew, size, *windowTables));
+            newGrain.prefetchTicket = prefetchTicket;
+            newGrain.filterSlot = spawnFilter();
+            grains.push_back(newGrain);
+            pushGrainEvent(GrainEvent::Type::spawned, newGrain);
+            SHATTER_TRACE_ASYNC_BEGIN("grain", newGrain.id);
+        }
         
         double grainFrequency = std::max(1.0, std::min(40.0, globalGrainFrequency + (randomizer.nextDouble() * 10 - 5) * grainFrequencyRandom));
         samplesToNextGrain = (int)(sampleRate / grainFrequency);
@@ -69,97 +286,443 @@ void GrainProcessor::spawnGrains(juce::AudioBuffer<float>& audioBuffer)
     samplesToNextGrain = samplesToNextGrain - (bufferSize - bufferIndex);
 }
 
+void GrainProcessor::spawnMicroGrains(juce::AudioBuffer<float>& audioBuffer)
+{
+    SHATTER_TRACE_SCOPE("spawnMicroGrains");
+    int bufferSize = audioBuffer.getNumSamples();
+    double interval = sampleRate / microGrainRate;
+    
+    while (samplesToNextMicroGrain < bufferSize)
+    {
+        int bufferIndex = (int) samplesToNextMicroGrain;
+        int size = std::max(2, (int) (microGrainSize * sampleRate * governor.getSizeScale()));
+        float pan = grainWidth == 0 ? 0.0f : (float) ((randomizer.nextDouble() * 2 - 1) * grainWidth);
+        
+        if (governor.shouldSpawn((int) grains.size() + microGrains.getNumActive(), randomizer.nextFloat()))
+        {
+            microGrains.add(getBufferStartPosition(bufferIndex, size, false), bufferIndex, size, pan);
+        }
+        
+        // density random jitters each gap by up to half of it either way
+        samplesToNextMicroGrain += std::max(1.0, interval * (1 + (randomizer.nextDouble() - 0.5) * grainFrequencyRandom));
+    }
+    
+    samplesToNextMicroGrain -= bufferSize;
+}
+
 void GrainProcessor::readFromGrains(juce::AudioBuffer<float>& audioBuffer)
 {
-    int audioBufferSize = audioBuffer.getNumSamples();
-    audioBuffer.clear();
-    juce::AudioBuffer<float> tempBuffer(delayBufferNumChannels, audioBufferSize);
+    SHATTER_TRACE_SCOPE("readFromGrains");
+    int bufferSize = audioBuffer.getNumSamples();
     
-    auto grain = grains.begin();
+    for (int channel = 0; channel < delayBufferNumChannels; ++channel)
+    {
+        wetBuffer.clear(channel, 0, bufferSize);
+    }
     
-    while (grain != grains.end())
+    numWetSamples = bufferSize;
+    
+    int maxTasks = taskBuffers.getNumChannels() / delayBufferNumChannels + 1;
+    int numTasks = juce::jlimit(1, maxTasks, (int) grains.size() / minGrainsPerTask);
+    float* const* wetChannels = wetBuffer.getArrayOfWritePointers();
+    float* const* taskChannels = taskBuffers.getArrayOfWritePointers();
+    float* const* filterChannels = filterBuffers.getArrayOfWritePointers();
+    
+    // each task takes an even share of the grains, nothing else is touched by more than one of them
+    auto mixGrains = [this, &audioBuffer, numTasks, bufferSize, wetChannels, taskChannels, filterChannels] (int task)
     {
-        tempBuffer.clear();
+        SHATTER_TRACE_SCOPE("mixGrains");
+        float* const* destination = task == 0 ? wetChannels : taskChannels + (task - 1) * delayBufferNumChannels;
+        float* const* laneChannels = filterChannels + task * GrainFilterBank::laneCount * delayBufferNumChannels;
         
-        int numSamplesRead = copyFromBufferWithWraparound(tempBuffer, *grain);
+        for (int channel = 0; task > 0 && channel < delayBufferNumChannels; ++channel)
+        {
+            juce::FloatVectorOperations::clear(destination[channel], bufferSize);
+        }
         
-        applyPanning(tempBuffer, *grain);
-        applyWindow(tempBuffer, *grain, numSamplesRead);
+        // filtered grains are gathered until there are enough to fill the lanes
+        size_t filteredGrains[GrainFilterBank::laneCount];
+        int numFilteredGrains = 0;
         
-        for (int channel = 0; channel < audioBuffer.getNumChannels(); channel++)
+        for (size_t i = grains.size() * (size_t) task / (size_t) numTasks; i < grains.size() * (size_t) (task + 1) / (size_t) numTasks; ++i)
         {
-            audioBuffer.addFrom(channel, 0, tempBuffer, channel, 0, audioBuffer.getNumSamples());
+            if (grains[i].filterSlot >= 0)
+            {
+                filteredGrains[numFilteredGrains++] = i;
+                
+                if (numFilteredGrains == GrainFilterBank::laneCount)
+                {
+                    mixFilteredGrains(audioBuffer, filteredGrains, numFilteredGrains, laneChannels, destination);
+                    numFilteredGrains = 0;
+                }
+                
+                continue;
+            }
+            
+            int numSamplesRead = mixFromBufferWithWraparound(audioBuffer, grains[i], destination);
+            updateGrain(grains[i], numSamplesRead);
         }
-
-        updateGrain(*grain, numSamplesRead);
         
+        if (numFilteredGrains > 0)
+        {
+            mixFilteredGrains(audioBuffer, filteredGrains, numFilteredGrains, laneChannels, destination);
+        }
+    };
+    
+    workerPool->run(numTasks, mixGrains);
+    
+    for (int task = 1; task < numTasks; ++task)
+    {
+        for (int channel = 0; channel < delayBufferNumChannels; ++channel)
+        {
+            juce::FloatVectorOperations::add(wetChannels[channel], taskChannels[(task - 1) * delayBufferNumChannels + channel], bufferSize);
+        }
+    }
+    
+    // filters of grains that finished in earlier blocks ring on, before this block's finished grains join them
+    filters.processTails(wetChannels, delayBufferNumChannels, bufferSize);
+    
+    // grains report where they are at the editor's frame rate, not every block
+    samplesSinceProgressEvents += bufferSize;
+    bool shouldReportProgress = samplesSinceProgressEvents >= sampleRate / GrainEventFifo::progressRate;
+    
+    if (shouldReportProgress)
+    {
+        samplesSinceProgressEvents = 0;
+    }
+    
+    auto grain = grains.begin();
+    
+    while (grain != grains.end())
+    {
         // check if grain is eaten
         if (grain->writeIndex >= grain->size)
         {
+            pushGrainEvent(GrainEvent::Type::finished, *grain);
+            SHATTER_TRACE_ASYNC_END("grain", grain->id);
+            filters.remove(grain->filterSlot);
             grain = grains.erase(grain);
         }
         else
         {
+            if (shouldReportProgress)
+            {
+                pushGrainEvent(GrainEvent::Type::progressed, *grain);
+            }
+            
             ++grain;
         }
     }
+    
+    // not culled by level like the long grains, at these sizes looking it up would cost as much as mixing
+    if (microGrains.getNumActive() > 0)
+    {
+        SHATTER_TRACE_SCOPE("mixMicroGrains");
+        int numChannels = std::min(audioBuffer.getNumChannels(), delayBufferNumChannels);
+        
+        if (delayStorage == DelayStorage::float16)
+        {
+            microGrains.mix(halfDelayChannels, delayBufferSize, wetChannels, numChannels, bufferSize);
+        }
+        else
+        {
+            microGrains.mix(delayBuffer->getArrayOfReadPointers(), delayBufferSize, wetChannels, numChannels, bufferSize);
+        }
+    }
 }
 
-int GrainProcessor::copyFromBufferWithWraparound(juce::AudioBuffer<float>& tempBuffer, Grain& grain)
+void GrainProcessor::mixToOutput(juce::AudioBuffer<float>& audioBuffer)
 {
+    // audioBuffer still holds the input, nothing in the engine adds latency so it lines up with the grains as it is
+    int bufferSize = audioBuffer.getNumSamples();
+    int numChannels = audioBuffer.getNumChannels();
+    
+    if (! dryGain.isSmoothing() && ! wetGain.isSmoothing())
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* output = audioBuffer.getWritePointer(channel);
+            const float* wet = wetBuffer.getReadPointer(std::min(channel, delayBufferNumChannels - 1));
+            
+            juce::FloatVectorOperations::multiply(output, dryGain.getTargetValue(), bufferSize);
+            juce::FloatVectorOperations::addWithMultiply(output, wet, wetGain.getTargetValue(), bufferSize);
+        }
+        
+        return;
+    }
+    
+    for (int i = 0; i < bufferSize; ++i)
+    {
+        float dry = dryGain.getNextValue();
+        float wet = wetGain.getNextValue();
+        
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            float* output = audioBuffer.getWritePointer(channel);
+            output[i] = output[i] * dry + wetBuffer.getSample(std::min(channel, delayBufferNumChannels - 1), i) * wet;
+        }
+    }
+}
+
+int GrainProcessor::mixFromBufferWithWraparound(juce::AudioBuffer<float>& audioBuffer, Grain& grain, float* const* destination)
+{
+    if (grain.isFromHistory && waitForPrefetch(grain, audioBuffer.getNumSamples()))
+    {
+        return 0;
+    }
+    
     int grainRelativeStartIndex = getRelativeStartIndex(grain);
     
     int grainSamplesRemaining = grain.size - grain.writeIndex;
-    int amountToCopy = std::min(grainSamplesRemaining, tempBuffer.getNumSamples() - grainRelativeStartIndex);
+    int amountToMix = std::min(grainSamplesRemaining, audioBuffer.getNumSamples() - grainRelativeStartIndex);
+    
+    int numChannels = std::min(audioBuffer.getNumChannels(), delayBufferNumChannels);
+    
+    // channels where the loudest sample this grain reads would be inaudible are left out,
+    // a grain that is silent everywhere just moves its window along
+    int firstSampleRead = grain.isReversed ? (grain.readIndex - amountToMix + 1 + delayBufferSize) % delayBufferSize : grain.readIndex;
+    float peak = grain.isFromHistory ? 1.0f : amplitudeIndex.getPeak(firstSampleRead, amountToMix);
+    
+    int audibleChannels[2];
+    float gains[2];
+    int numAudibleChannels = 0;
     
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        float gain = getPanningGain(grain, channel);
+        
+        if (gain * peak >= silenceThreshold)
+        {
+            audibleChannels[numAudibleChannels] = channel;
+            gains[numAudibleChannels++] = gain;
+        }
+    }
+    
+    if (numAudibleChannels == 0)
+    {
+        grain.window.advance(amountToMix);
+        return amountToMix;
+    }
+    
+    if (grain.isFromHistory)
+    {
+        mixGrainRuns(history->getChannels(), history->getLength(), grain, destination, audibleChannels, gains, numAudibleChannels, grainRelativeStartIndex, amountToMix);
+    }
+    else if (delayStorage == DelayStorage::float16)
+    {
+        mixGrainRuns(halfDelayChannels, delayBufferSize, grain, destination, audibleChannels, gains, numAudibleChannels, grainRelativeStartIndex, amountToMix);
+    }
+    else
+    {
+        mixGrainRuns(delayBuffer->getArrayOfReadPointers(), delayBufferSize, grain, destination, audibleChannels, gains, numAudibleChannels, grainRelativeStartIndex, amountToMix);
+    }
+    
+    return amountToMix;
+}
+
+template <typename SampleType>
+void GrainProcessor::mixGrainRuns(const SampleType* const* ringBuffer, int ringBufferSize, Grain& grain, float* const* destination, const int* channels, const float* gains,
+                                  int numChannels, int startIndex, int numSamples)
+{
+    // the window is applied while mixing, in at most two runs either side of the wraparound,
+    // reversed grains read straight from the ring buffer with a negative stride
+    int firstRunLength = std::min(numSamples, grain.isReversed ? grain.readIndex + 1 : ringBufferSize - grain.readIndex);
+    
+    const SampleType* source[2];
+    float* output[2];
+    for (int i = 0; i < numChannels; ++i)
+    {
+        source[i] = ringBuffer[channels[i]] + grain.readIndex;
+        output[i] = destination[channels[i]] + startIndex;
+    }
+    
+    grain.window.mix(source, output, gains, numChannels, firstRunLength, grain.isReversed);
+    
+    if (firstRunLength < numSamples)
+    {
+        for (int i = 0; i < numChannels; ++i)
+        {
+            source[i] = ringBuffer[channels[i]] + (grain.isReversed ? ringBufferSize - 1 : 0);
+            output[i] += firstRunLength;
+        }
+        
+        grain.window.mix(source, output, gains, numChannels, numSamples - firstRunLength, grain.isReversed);
+    }
+}
+
+void GrainProcessor::mixFilteredGrains(juce::AudioBuffer<float>& audioBuffer, const size_t* grainIndices, int numGrains, float* const* laneChannels, float* const* destination)
+{
+    int bufferSize = audioBuffer.getNumSamples();
+    int slots[GrainFilterBank::laneCount];
+    
+    // every lane is cleared, so the ones without a grain feed the filters silence
+    for (int channel = 0; channel < GrainFilterBank::laneCount * delayBufferNumChannels; ++channel)
+    {
+        juce::FloatVectorOperations::clear(laneChannels[channel], bufferSize);
+    }
+    
+    for (int lane = 0; lane < numGrains; ++lane)
+    {
+        Grain& grain = grains[grainIndices[lane]];
+        int numSamplesRead = mixFromBufferWithWraparound(audioBuffer, grain, laneChannels + lane * delayBufferNumChannels);
+        updateGrain(grain, numSamplesRead);
+        slots[lane] = grain.filterSlot;
+    }
+    
+    // the whole block is filtered, so a grain that started partway through still rings on to the end of it
     for (int channel = 0; channel < delayBufferNumChannels; ++channel)
     {
-        if (grain.readIndex + amountToCopy < delayBufferSize)
+        const float* inputs[GrainFilterBank::laneCount];
+        for (int lane = 0; lane < GrainFilterBank::laneCount; ++lane)
         {
-            tempBuffer.copyFrom(channel, grainRelativeStartIndex, *delayBuffer, channel, grain.readIndex, amountToCopy);
+            inputs[lane] = laneChannels[lane * delayBufferNumChannels + channel];
         }
-        else
+        
+        filters.process(slots, numGrains, inputs, destination[channel], channel, bufferSize);
+    }
+}
+
+int GrainProcessor::spawnFilter()
+{
+    if (filterMode == GrainFilterMode::off)
+    {
+        return -1;
+    }
+    
+    // the spread moves the cutoff up to that many octaves either way, and the resonance up to half as far
+    double cutoff = filterCutoff * std::pow(2.0, (randomizer.nextDouble() * 2 - 1) * filterSpread);
+    double resonance = filterResonance * std::pow(2.0, (randomizer.nextDouble() - 0.5) * filterSpread);
+    
+    return filters.add(filterMode, juce::jlimit(20.0, 0.45 * sampleRate, cutoff), juce::jlimit(0.5, 20.0, resonance), sampleRate);
+}
+
+int GrainProcessor::getStartPosition(int writePosition)
+{
+    int spreadSamples = (int) (grainSpread * sampleRate);
+    
+    // anywhere within the spread behind the write head, drawn by the placement's weights when it has any
+    if (grainPlacement != GrainPlacement::uniform && spreadSamples > 0)
+    {
+        int searchStart = (writePosition - spreadSamples + delayBufferSize) % delayBufferSize;
+        int position = amplitudeIndex.pickPosition(searchStart, spreadSamples + 1, randomizer.nextFloat(), randomizer.nextFloat());
+        
+        if (position >= 0)
         {
-            int samplesRemaining = delayBufferSize - grain.readIndex;
-            
-            tempBuffer.copyFrom(channel, grainRelativeStartIndex, *delayBuffer, channel, grain.readIndex, samplesRemaining);
-            tempBuffer.copyFrom(channel, grainRelativeStartIndex + samplesRemaining, *delayBuffer, channel, 0, amountToCopy - samplesRemaining);
+            return position;
         }
     }
     
-    return amountToCopy;
+    int startPosition = writePosition - (int) (randomizer.nextDouble() * spreadSamples);
+    if (startPosition < 0)  { startPosition += delayBufferSize; }
+    
+    return startPosition;
 }
 
-void GrainProcessor::applyPanning(juce::AudioBuffer<float>& tempBuffer, Grain& grain)
+int GrainProcessor::getHistoryStartPosition(juce::int64 spawnFrame, int ageSamples, int grainSize, bool isReversed, juce::int64& prefetchTicket)
 {
-    if (grain.panning > 0)
+    juce::int64 startFrame = spawnFrame - ageSamples - (juce::int64) (randomizer.nextDouble() * grainSpread * sampleRate);
+    juce::int64 firstFrame = isReversed ? startFrame - grainSize + 1 : startFrame;
+    
+    // everything the grain reads has to be in the file already, and stay there while the writer
+    // keeps going, a second is more than the longest grain can fall behind by, and until the file
+    // has wrapped nothing before its first frame exists
+    juce::int64 framesRecorded = history->getNumFramesRecorded();
+    juce::int64 oldestFrame = std::max<juce::int64>(0, framesRecorded - history->getLength() + (juce::int64) sampleRate);
+    
+    if (firstFrame + grainSize > framesRecorded || firstFrame < oldestFrame)
     {
-        tempBuffer.applyGain(0, 0, tempBuffer.getNumSamples(), 1 - grain.panning);
+        return -1;
     }
-    else if (grain.panning < 0)
+    
+    prefetchTicket = history->prefetch((int) (firstFrame % history->getLength()), grainSize);
+    
+    if (prefetchTicket < 0)
     {
-        tempBuffer.applyGain(1, 0, tempBuffer.getNumSamples(), 1 + grain.panning);
+        return -1;
     }
+    
+    return (int) (startFrame % history->getLength());
 }
 
-void GrainProcessor::applyWindow(juce::AudioBuffer<float>& tempBuffer, Grain& grain, int numSamplesRead)
+bool GrainProcessor::waitForPrefetch(Grain& grain, int numSamples)
 {
-    int grainRelativeStartIndex = getRelativeStartIndex(grain);
+    if (grain.writeIndex > 0 || history->isPrefetched(grain.prefetchTicket))
+    {
+        return false;
+    }
+    
+    // starts with the first block after its pages are in, and gives up well before the writer could reach them
+    grain.relativeStartIndex = 0;
+    grain.samplesWaited += numSamples;
     
-    for (int channel = 0; channel < tempBuffer.getNumChannels(); ++channel)
+    if (grain.samplesWaited > (int) (maxPrefetchWait * sampleRate))
     {
-        for (int i = 0; i < numSamplesRead; ++i)
-        {
-            int windowReadIndex = i + grain.writeIndex;
+        grain.writeIndex = grain.size;
+    }
+    
+    return true;
+}
 
-            *tempBuffer.getWritePointer(channel, i + grainRelativeStartIndex) = tempBuffer.getSample(channel, i + grainRelativeStartIndex) * grain.window[windowReadIndex];
-        }
+int GrainProcessor::snapToZeroCrossing(int startPosition, int livePosition)
+{
+    // never later than the sample being written at the grain's start, it would read ahead of the input
+    int maxSnap = (int) (zeroSnapSeconds * sampleRate);
+    int lag = (livePosition - startPosition + delayBufferSize) % delayBufferSize;
+    int crossing = zeroCrossings.findNearest(startPosition, maxSnap, std::min(maxSnap, lag));
+    
+    return crossing >= 0 ? crossing : startPosition;
+}
+
+int GrainProcessor::getBufferStartPosition(int bufferIndex, int grainSize, bool isReversed)
+{
+    // as old as delayBuffer allows at most
+    int ageSamples = std::min((int) (grainAge * sampleRate), getMaximumBufferAge(grainSize, isReversed));
+    int startPosition = getStartPosition((delayBufferWriteIndex + bufferIndex - ageSamples + delayBufferSize) % delayBufferSize);
+    
+    if (zeroSnap)
+    {
+        startPosition = snapToZeroCrossing(startPosition, (delayBufferWriteIndex + bufferIndex) % delayBufferSize);
+    }
+    
+    return startPosition;
+}
+
+int GrainProcessor::getMaximumBufferAge(int grainSize, bool isReversed)
+{
+    // leaves room for the spread, the zero snap, the grain and a block so nothing reads what is being written,
+    // a reversed grain reads away from the write head as it moves on, so it ends up twice its size older
+    int grainReserve = isReversed ? 2 * grainSize : grainSize;
+    int snapReserve = zeroSnap ? (int) (zeroSnapSeconds * sampleRate) : 0;
+    
+    return std::max(0, delayBufferSize - (int) (grainSpread * sampleRate) - snapReserve - grainReserve - wetBuffer.getNumSamples());
+}
+
+float GrainProcessor::getPanningGain(const Grain& grain, int channel)
+{
+    if (channel == 0 && grain.panning > 0)
+    {
+        return (float) (1 - grain.panning);
+    }
+    else if (channel == 1 && grain.panning < 0)
+    {
+        return (float) (1 + grain.panning);
     }
+    
+    return 1.0f;
 }
 
 void GrainProcessor::updateGrain(Grain& grain, int numSamplesWritten)
 {
-    grain.readIndex = (grain.readIndex + numSamplesWritten) % delayBufferSize;
+    int ringBufferSize = grain.isFromHistory ? history->getLength() : delayBufferSize;
+    
+    if (grain.isReversed)
+    {
+        grain.readIndex = (grain.readIndex - numSamplesWritten + ringBufferSize) % ringBufferSize;
+    }
+    else
+    {
+        grain.readIndex = (grain.readIndex + numSamplesWritten) % ringBufferSize;
+    }
     grain.writeIndex += numSamplesWritten;
 }
 
@@ -176,7 +739,227 @@ int GrainProcessor::getRelativeStartIndex(Grain grain)
     }
 }
 
-void GrainProcessor::setSampleRate(double sr)                   { sampleRate = sr; }
+void GrainProcessor::pushGrainEvent(GrainEvent::Type type, const Grain& grain)
+{
+    // the visualiser only shows delayBuffer
+    if (grain.isFromHistory)
+    {
+        return;
+    }
+    
+    grainEvents.push({ type, grain.id, (float) grain.readIndex / delayBufferSize, (float) grain.size / delayBufferSize,
+                       (float) grain.panning, (float) grain.writeIndex / grain.size });
+}
+
+void GrainProcessor::pushWaveformEvents(int numSamplesWritten)
+{
+    // one peak per column of the visualiser, sent as each column fills up
+    int samplesPerColumn = delayBufferSize / numWaveformColumns;
+    int writeIndex = delayBufferWriteIndex;
+    int samplesRemaining = numSamplesWritten;
+    
+    while (samplesRemaining > 0)
+    {
+        int column = std::min(writeIndex / samplesPerColumn, numWaveformColumns - 1);
+        int columnEnd = column == numWaveformColumns - 1 ? delayBufferSize : (column + 1) * samplesPerColumn;
+        int spanLength = std::min(samplesRemaining, columnEnd - writeIndex);
+        
+        waveformPeak = std::max(waveformPeak, amplitudeIndex.getPeak(writeIndex, spanLength));
+        
+        writeIndex = (writeIndex + spanLength) % delayBufferSize;
+        samplesRemaining -= spanLength;
+        
+        if (writeIndex == columnEnd % delayBufferSize)
+        {
+            grainEvents.push({ GrainEvent::Type::waveform, column, waveformPeak, 0.0f, 0.0f, 0.0f });
+            waveformPeak = 0.0f;
+        }
+    }
+}
+
+GrainEventFifo& GrainProcessor::getGrainEvents()                { return grainEvents; }
+GrainGovernor& GrainProcessor::getGovernor()                    { return governor; }
+
+void GrainProcessor::prepare(double sr, int maximumBlockSize)
+{
+    sampleRate = sr;
+    governor.prepare(sr);
+    
+    dryGain.reset(sr, 0.05);
+    wetGain.reset(sr, 0.05);
+    
+    // the workers have to be running for the task buffers to be sized for them
+    if (! isPrepared)
+    {
+        workerPool->addUser();
+    }
+    
+    workerPool->setBlockPeriod(std::max(1, maximumBlockSize) / sr);
+    
+    setMaximumBlockSize(std::max(1, maximumBlockSize));
+    
+    if (! isPrepared)
+    {
+        grains.reserve(maxGrains);
+        microGrains.prepare();
+        filters.prepare(maxGrains);
+    }
+    
+    // the delay buffer holds the same time at every sample rate, so it's kept when only the block size changes
+    int newDelayBufferSize = (int) (delayBufferSeconds * sr);
+    
+    if (! isPrepared || newDelayBufferSize != delayBufferSize)
+    {
+        delayBufferSize = newDelayBufferSize;
+        allocateDelayBuffer();
+    }
+    
+    isPrepared = true;
+    
+    // and so does the history file
+    setLongHistoryLength(longHistoryLength);
+}
+
+void GrainProcessor::release()
+{
+    if (isPrepared)
+    {
+        workerPool->removeUser();
+    }
+    
+    isPrepared = false;
+    
+   #if SHATTER_ENABLE_TRACING
+    for (const Grain& grain : grains)
+    {
+        SHATTER_TRACE_ASYNC_END("grain", grain.id);
+    }
+   #endif
+    
+    grains.clear();
+    grains.shrink_to_fit();
+    microGrains.release();
+    filters.release();
+    
+    delayBuffer->setSize(0, 0);
+    halfDelayBuffer.free();
+    halfDelayChannels[0] = halfDelayChannels[1] = nullptr;
+    halfWriteBuffer.setSize(0, 0);
+    wetBuffer.setSize(0, 0);
+    taskBuffers.setSize(0, 0);
+    filterBuffers.setSize(0, 0);
+    numWetSamples = 0;
+    
+    amplitudeIndex.release();
+    zeroCrossings.release();
+    history.reset();
+}
+
+void GrainProcessor::setMaximumBlockSize(int maximumBlockSize)
+{
+    wetBuffer.setSize(delayBufferNumChannels, maximumBlockSize, false, true, true);
+    numWetSamples = 0;
+    
+    int numTaskBuffers = std::min(maxRenderTasks, workerPool->getNumWorkers() + 1) - 1;
+    taskBuffers.setSize(delayBufferNumChannels * numTaskBuffers, maximumBlockSize, false, false, true);
+    filterBuffers.setSize(delayBufferNumChannels * GrainFilterBank::laneCount * (numTaskBuffers + 1), maximumBlockSize, false, false, true);
+    
+    if (delayStorage == DelayStorage::float16)
+    {
+        halfWriteBuffer.setSize(delayBufferNumChannels, maximumBlockSize, false, false, true);
+    }
+}
+
+void GrainProcessor::setDelayStorage(DelayStorage storage)
+{
+    if (storage == delayStorage)
+    {
+        return;
+    }
+    
+    delayStorage = storage;
+    
+    if (isPrepared)
+    {
+        allocateDelayBuffer();
+    }
+}
+
+void GrainProcessor::allocateDelayBuffer()
+{
+    if (delayStorage == DelayStorage::float16)
+    {
+        halfDelayBuffer.calloc((size_t) delayBufferNumChannels * (size_t) delayBufferSize);
+        halfWriteBuffer.setSize(delayBufferNumChannels, wetBuffer.getNumSamples());
+        delayBuffer->setSize(delayBufferNumChannels, 0);
+    }
+    else
+    {
+        delayBuffer->setSize(delayBufferNumChannels, delayBufferSize);
+        delayBuffer->clear();
+        halfDelayBuffer.free();
+        halfWriteBuffer.setSize(0, 0);
+    }
+    
+    for (int channel = 0; channel < delayBufferNumChannels; ++channel)
+    {
+        halfDelayChannels[channel] = halfDelayBuffer.get() == nullptr ? nullptr : halfDelayBuffer.get() + (size_t) channel * (size_t) delayBufferSize;
+    }
+    
+    // what the grains were reading is gone
+   #if SHATTER_ENABLE_TRACING
+    for (const Grain& grain : grains)
+    {
+        SHATTER_TRACE_ASYNC_END("grain", grain.id);
+    }
+   #endif
+    
+    grains.clear();
+    microGrains.clear();
+    filters.clear();
+    amplitudeIndex.prepare(delayBufferSize);
+    zeroCrossings.prepare(delayBufferSize);
+    delayBufferWriteIndex = 0;
+}
+
+DelayStorage GrainProcessor::getDelayStorage()                  { return delayStorage; }
+
+void GrainProcessor::setLongHistoryLength(double seconds)
+{
+    int length = (int) (seconds * sampleRate);
+    bool isUpToDate = history != nullptr ? history->getLength() == length : (length <= 0 || ! isPrepared);
+    
+    if (seconds == longHistoryLength && isUpToDate)
+    {
+        return;
+    }
+    
+    longHistoryLength = seconds;
+    
+    for (const Grain& grain : grains)
+    {
+        if (grain.isFromHistory)
+        {
+            SHATTER_TRACE_ASYNC_END("grain", grain.id);
+            filters.remove(grain.filterSlot);
+        }
+    }
+    
+    grains.erase(std::remove_if(grains.begin(), grains.end(), [] (const Grain& grain) { return grain.isFromHistory; }), grains.end());
+    history.reset();
+    
+    if (length > 0 && isPrepared)
+    {
+        history = std::make_unique<HistoryFile>(delayBufferNumChannels, length);
+        
+        if (! history->isValid())
+        {
+            history.reset();
+        }
+    }
+}
+
+double GrainProcessor::getLongHistoryLength()                  { return longHistoryLength; }
 
 void GrainProcessor::setGrainSize(double grainSize)             { globalGrainSize = grainSize; }
 void GrainProcessor::setGrainFrequency(double grainFrequency)   { globalGrainFrequency = grainFrequency; }
@@ -184,6 +967,41 @@ void GrainProcessor::setGrainWidth(double width)                { grainWidth = w
 void GrainProcessor::setGrainRandomSize(double randomAmount)    { grainSizeRandom = randomAmount; }
 void GrainProcessor::setGrainRandomFreq(double randomAmount)    { grainFrequencyRandom = randomAmount; }
 void GrainProcessor::setGrainSpread(double spreadMilliseconds)  { grainSpread = spreadMilliseconds / 1000; }
+void GrainProcessor::setWindowShape(WindowShape shape)          { windowShape = shape; }
+void GrainProcessor::setWindowSkew(double skew)                 { windowSkew = skew; }
+
+void GrainProcessor::setReverseProbability(double probability) { reverseProbability = probability; }
+void GrainProcessor::setFeedback(double feedback)               { feedbackAmount = feedback; }
+
+void GrainProcessor::setGrainAge(double seconds)                { grainAge = seconds; }
+void GrainProcessor::setMicroMode(bool isMicro)                 { microMode = isMicro; }
+void GrainProcessor::setMicroGrainSize(double milliseconds)     { microGrainSize = milliseconds / 1000; }
+void GrainProcessor::setMicroGrainRate(double grainsPerSecond)  { microGrainRate = grainsPerSecond; }
+void GrainProcessor::setFilterMode(GrainFilterMode mode)        { filterMode = mode; }
+void GrainProcessor::setFilterCutoff(double frequency)          { filterCutoff = frequency; }
+void GrainProcessor::setFilterResonance(double resonance)       { filterResonance = resonance; }
+void GrainProcessor::setFilterSpread(double octaves)            { filterSpread = octaves; }
+
+void GrainProcessor::setMix(double mix)
+{
+    dryWetMix = mix;
+    dryGain.setTargetValue((float) (outputGain * (1 - dryWetMix)));
+    wetGain.setTargetValue((float) (outputGain * dryWetMix));
+}
+
+void GrainProcessor::setOutputGain(double gain)
+{
+    outputGain = gain;
+    setMix(dryWetMix);
+}
+
+void GrainProcessor::setGrainPlacement(GrainPlacement placement)
+{
+    grainPlacement = placement;
+    amplitudeIndex.setPlacement(placement);
+}
+
+void GrainProcessor::setZeroSnap(bool shouldSnap)               { zeroSnap = shouldSnap; }
 
 double GrainProcessor::getGrainSize()                           { return globalGrainSize; }
 double GrainProcessor::getGrainFrequency()                      { return globalGrainFrequency; }
@@ -191,6 +1009,22 @@ double GrainProcessor::getGrainRandomSize()                     { return grainSi
 double GrainProcessor::getGrainRandomFreq()                     { return grainFrequencyRandom; }
 double GrainProcessor::getGrainWidth()                          { return grainWidth; }
 double GrainProcessor::getGrainSpread()                         { return grainSpread; }
+WindowShape GrainProcessor::getWindowShape()                    { return windowShape; }
+double GrainProcessor::getWindowSkew()                          { return windowSkew; }
+GrainPlacement GrainProcessor::getGrainPlacement()              { return grainPlacement; }
+bool GrainProcessor::getZeroSnap()                              { return zeroSnap; }
+double GrainProcessor::getReverseProbability()                  { return reverseProbability; }
+double GrainProcessor::getFeedback()                            { return feedbackAmount; }
+double GrainProcessor::getGrainAge()                            { return grainAge; }
+bool GrainProcessor::getMicroMode()                             { return microMode; }
+double GrainProcessor::getMicroGrainSize()                      { return microGrainSize * 1000; }
+double GrainProcessor::getMicroGrainRate()                      { return microGrainRate; }
+GrainFilterMode GrainProcessor::getFilterMode()                 { return filterMode; }
+double GrainProcessor::getFilterCutoff()                        { return filterCutoff; }
+double GrainProcessor::getFilterResonance()                     { return filterResonance; }
+double GrainProcessor::getFilterSpread()                        { return filterSpread; }
+double GrainProcessor::getMix()                                 { return dryWetMix; }
+double GrainProcessor::getOutputGain()                          { return outputGain; }
 
 
 void GrainProcessor::testDelayBuffer(juce::AudioBuffer<float>& audioBuffer)
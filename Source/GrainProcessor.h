@@ -1,35 +1,72 @@
 #pragma once
 #include <JuceHeader.h>
+#include "GrainWindow.h"
+#include "GrainEvents.h"
+#include "GrainGovernor.h"
+#include "AmplitudeIndex.h"
+#include "ZeroCrossingIndex.h"
+#include "MicroGrainCloud.h"
+#include "GrainFilterBank.h"
+#include "HistoryFile.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+
+// sample format of the delay buffer, half precision halves its memory and the bandwidth grains read with
+enum class DelayStorage
+{
+    float32 = 0,
+    float16
+};
 
 struct Grain
 {
-    Grain(int grainSize, double grainPanning, int startPosition, int startIndex) : size(grainSize), readIndex(startPosition),
-        writeIndex(0), relativeStartIndex(startIndex), panning(grainPanning)
+    Grain(int grainID, int grainSize, double grainPanning, bool reversed, bool fromHistory, int startPosition, int startIndex, const GrainWindow& grainWindow) : id(grainID),
+        size(grainSize), readIndex(startPosition), writeIndex(0), relativeStartIndex(startIndex), panning(grainPanning), isReversed(reversed),
+        isFromHistory(fromHistory), window(grainWindow)
     {
-        //create hanning window
-        window.resize(size);
-        for (int i = 0; i < size; ++i)
-        {
-            window[i] = pow(sin(((float)i / size) * M_PI), 2);
-        }
     }
     
+    int id;
     int size;
     int readIndex;  // position in delayBuffer
     int writeIndex; // position in grain
     int relativeStartIndex;
     double panning;
+    bool isReversed;    // reads backwards through delayBuffer from where it started
+    bool isFromHistory; // reads from the long history file instead of delayBuffer
+    int filterSlot = -1;    // in the processor's filters, -1 when the grain isn't filtered
+    juce::int64 prefetchTicket = -1;    // history grains wait for the file's pages to be faulted in before they start
+    int samplesWaited = 0;
 
-    std::vector<float> window;
+    GrainWindow window;
 };
 
 class GrainProcessor
 {
 public:
     GrainProcessor();
+    ~GrainProcessor();
     
+    // nothing big is allocated until the first prepare, so constructing one for a plugin scan is cheap,
+    // preparing again at the same sample rate keeps the delay buffer and only resizes what changed
+    void prepare(double sr, int maximumBlockSize);
+    void release();
     void grainify(juce::AudioBuffer<float>& audioBuffer);
-    void setSampleRate(double sr);
+    
+    // the kernels grainify is built from, on their own for the benchmarks, a prepared processor only:
+    // the delay buffer write with its feedback, indices and history, and one grain read through its window
+    // with the level culling and panning, which returns how many of the grain's samples it covered
+    void writeBlock(juce::AudioBuffer<float>& audioBuffer);
+    int mixGrain(juce::AudioBuffer<float>& audioBuffer, Grain& grain, float* const* destination);
+    
+    // reallocates the delay buffer and drops its contents when prepared, so not while grainify can run
+    void setDelayStorage(DelayStorage storage);
+    DelayStorage getDelayStorage();
+    
+    // records the input to disk for this many seconds back, 0 turns it off, also not while grainify can run,
+    // the file is only created while prepared
+    void setLongHistoryLength(double seconds);
+    double getLongHistoryLength();
     
     void setGrainSize(double grainSize);
     void setGrainRandomSize(double randomAmount);
@@ -37,6 +74,22 @@ public:
     void setGrainRandomFreq(double randomAmount);
     void setGrainWidth(double width);
     void setGrainSpread(double spread);
+    void setWindowShape(WindowShape shape);
+    void setWindowSkew(double skew);
+    void setGrainPlacement(GrainPlacement placement);
+    void setZeroSnap(bool shouldSnap);
+    void setReverseProbability(double probability);
+    void setFeedback(double feedback);
+    void setGrainAge(double seconds);
+    void setMicroMode(bool isMicro);
+    void setMicroGrainSize(double milliseconds);
+    void setMicroGrainRate(double grainsPerSecond);
+    void setFilterMode(GrainFilterMode mode);
+    void setFilterCutoff(double frequency);
+    void setFilterResonance(double resonance);
+    void setFilterSpread(double octaves);
+    void setMix(double mix);
+    void setOutputGain(double gain);
     
     double getGrainSize();
     double getGrainFrequency();
@@ -44,18 +97,59 @@ public:
     double getGrainRandomFreq();
     double getGrainWidth();
     double getGrainSpread();
+    WindowShape getWindowShape();
+    double getWindowSkew();
+    GrainPlacement getGrainPlacement();
+    bool getZeroSnap();
+    double getReverseProbability();
+    double getFeedback();
+    double getGrainAge();
+    bool getMicroMode();
+    double getMicroGrainSize();
+    double getMicroGrainRate();
+    GrainFilterMode getFilterMode();
+    double getFilterCutoff();
+    double getFilterResonance();
+    double getFilterSpread();
+    double getMix();
+    double getOutputGain();
+    
+    // read by the editor's grain visualiser
+    GrainEventFifo& getGrainEvents();
+    static constexpr int numWaveformColumns = 512;
+    
+    GrainGovernor& getGovernor();
+    static constexpr int maxGrains = 256;   // grains are reserved up front, spawns past this are dropped
 
 private:
     void spawnGrains(juce::AudioBuffer<float>& audioBuffer);
+    void spawnMicroGrains(juce::AudioBuffer<float>& audioBuffer);
     void readFromGrains(juce::AudioBuffer<float>& audioBuffer);
+    void mixToOutput(juce::AudioBuffer<float>& audioBuffer);
     void writeToDelayBuffer(juce::AudioBuffer<float>& audioBuffer);
+    void blockFeedbackDC(int channel, int numSamples);
+    void allocateDelayBuffer();
+    void setMaximumBlockSize(int maximumBlockSize);
     
-    int copyFromBufferWithWraparound(juce::AudioBuffer<float>& tempBuffer, Grain& grain);
+    int mixFromBufferWithWraparound(juce::AudioBuffer<float>& audioBuffer, Grain& grain, float* const* destination);
+    template <typename SampleType>
+    void mixGrainRuns(const SampleType* const* ringBuffer, int ringBufferSize, Grain& grain, float* const* destination, const int* channels, const float* gains,
+                      int numChannels, int startIndex, int numSamples);
+    void mixFilteredGrains(juce::AudioBuffer<float>& audioBuffer, const size_t* grainIndices, int numGrains, float* const* laneChannels, float* const* destination);
+    int spawnFilter();
     int getRelativeStartIndex(Grain grain);
+    int getStartPosition(int writePosition);
+    int getHistoryStartPosition(juce::int64 spawnFrame, int ageSamples, int grainSize, bool isReversed, juce::int64& prefetchTicket);
+    bool waitForPrefetch(Grain& grain, int numSamples);
+    int getMaximumBufferAge(int grainSize, bool isReversed);
+    int snapToZeroCrossing(int startPosition, int livePosition);
+    int getBufferStartPosition(int bufferIndex, int grainSize, bool isReversed);
     
-    void applyPanning(juce::AudioBuffer<float>& tempBuffer, Grain& grain);
-    void applyWindow(juce::AudioBuffer<float>& tempBuffer, Grain& grain, int numSamplesRead);
+    float getPanningGain(const Grain& grain, int channel);
     void updateGrain(Grain& grain, int numSamplesWritten);
+    
+    void pushGrainEvent(GrainEvent::Type type, const Grain& grain);
+    void pushWaveformEvents(int numSamplesWritten);
 
     void testDelayBuffer(juce::AudioBuffer<float>& audioBuffer);
     
@@ -64,10 +158,52 @@ private:
 
     std::unique_ptr<juce::AudioBuffer<float>> delayBuffer;
     
+    // used instead of delayBuffer, which is then left empty, when storing half precision
+    DelayStorage delayStorage;
+    juce::HeapBlock<Float16> halfDelayBuffer;
+    Float16* halfDelayChannels[2];
+    juce::AudioBuffer<float> halfWriteBuffer;   // the block with feedback mixed in, before it's narrowed
+    
+    bool isPrepared;
+    
+    std::unique_ptr<HistoryFile> history;
+    double longHistoryLength;
+    static constexpr double maxPrefetchWait = 0.25;    // seconds, well inside the second of slack getHistoryStartPosition leaves
+    AmplitudeIndex amplitudeIndex;
+    ZeroCrossingIndex zeroCrossings;
+    static constexpr double zeroSnapSeconds = 0.01;     // furthest a start is moved to reach a zero crossing
+    
+    // grains are rendered here first, and the block stays put so the next one can feed it back
+    juce::AudioBuffer<float> wetBuffer;
+    int numWetSamples;
+    
+    // large clouds are mixed by several tasks on the shared workers, the first into wetBuffer
+    // and the rest into their own channels here, which are then added up
+    juce::SharedResourcePointer<WorkerPool> workerPool;
+    juce::AudioBuffer<float> taskBuffers;
+    static constexpr int maxRenderTasks = 8;
+    static constexpr int minGrainsPerTask = 8;
+    
+    // filtered grains are mixed into a channel per lane here first, laneCount lanes for every task
+    GrainFilterBank filters;
+    juce::AudioBuffer<float> filterBuffers;
+    
+    struct FeedbackFilter
+    {
+        float lastInput = 0.0f;
+        float lastOutput = 0.0f;
+    };
+    
+    FeedbackFilter feedbackFilters[2];
+    float appliedFeedback;
+    static constexpr float silenceThreshold = 1.0e-5f;  // -100 dB, grains quieter than this on a channel aren't mixed
+    
     int delayBufferSize;
+    static constexpr double delayBufferSeconds = 4.0;   // the widest spread, a reversed grain's two seconds and some age
     int delayBufferNumChannels;
     int delayBufferWriteIndex;
     int samplesToNextGrain;
+    int nextGrainID;
     
     double globalGrainSize;         // grain size in terms of seconds
     double grainSizeRandom;
@@ -75,6 +211,40 @@ private:
     double grainFrequencyRandom;
     double grainWidth;
     double grainSpread;
+    GrainPlacement grainPlacement;
+    bool zeroSnap;
+    double reverseProbability;
+    double feedbackAmount;
+    double grainAge;        // seconds behind the write head that spawning is centred on
+    
+    // micro mode spawns into microGrains instead, long grains already playing finish as usual
+    MicroGrainCloud microGrains;
+    bool microMode;
+    double microGrainSize;          // seconds
+    double microGrainRate;          // grains per second
+    double samplesToNextMicroGrain; // fractional, so high rates keep their exact spacing
+    
+    // each grain's filter is drawn when it spawns, later changes only reach new grains
+    GrainFilterMode filterMode;
+    double filterCutoff;            // hz
+    double filterResonance;         // q
+    double filterSpread;            // octaves either way
+    double dryWetMix;
+    double outputGain;
+    
+    // gain of the input and of the grains in the output, smoothed per sample
+    juce::SmoothedValue<float> dryGain;
+    juce::SmoothedValue<float> wetGain;
+    
+    WindowShape windowShape;
+    double windowSkew;
+    juce::SharedResourcePointer<WindowTables> windowTables;
     
     juce::Random randomizer;
+    
+    GrainEventFifo grainEvents;
+    float waveformPeak;
+    int samplesSinceProgressEvents;
+    
+    GrainGovernor governor;
 };
@@ -0,0 +1,166 @@
+#include "GrainVisualiser.h"
+
+
+GrainVisualiser::GrainVisualiser(GrainEventFifo& eventFifo, GrainGovernor& grainGovernor) : grainEvents(eventFifo), governor(grainGovernor)
+{
+    outlineThickness = 2;
+    curveAmount = 15;
+    
+    // events queued while the editor was closed describe grains that are long gone,
+    // the ones still playing show up again with their next progressed event
+    grainEvents.discardAll();
+    startTimerHz(frameRate);
+}
+
+GrainVisualiser::~GrainVisualiser()
+{
+    stopTimer();
+}
+
+void GrainVisualiser::paint(juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().reduced(outlineThickness).toFloat();
+    
+    g.setColour (juce::Colours::darkslategrey);
+    g.fillRoundedRectangle(bounds, curveAmount);
+    
+    g.setColour (juce::Colours::black);
+    g.drawRoundedRectangle(bounds, curveAmount, outlineThickness);
+    
+    auto area = bounds.reduced(curveAmount, outlineThickness * 4.0f);
+    float columnWidth = area.getWidth() / waveform.size();
+    float centreY = area.getCentreY();
+    
+    // buffer waveform, one column per peak
+    g.setColour (juce::Colours::white.withAlpha(0.35f));
+    for (size_t column = 0; column < waveform.size(); ++column)
+    {
+        float halfHeight = std::min(1.0f, waveform[column]) * area.getHeight() * 0.5f;
+        g.fillRect(area.getX() + column * columnWidth, centreY - halfHeight, std::max(1.0f, columnWidth), halfHeight * 2);
+    }
+    
+    // write head
+    g.setColour (juce::Colours::darkred);
+    g.fillRect(area.getX() + writeColumn * columnWidth, area.getY(), 2.0f, area.getHeight());
+    
+    // grains, placed by read position and pan, faded by their envelope
+    for (auto& [id, grain] : activeGrains)
+    {
+        float envelope = std::sin(grain.phase * juce::MathConstants<float>::pi);
+        float x = area.getX() + grain.position * area.getWidth();
+        float y = centreY + grain.pan * area.getHeight() * 0.4f;
+        float width = std::max(3.0f, grain.size * area.getWidth());
+        
+        g.setColour (juce::Colours::snow.withAlpha(0.25f + 0.75f * envelope));
+        g.fillRoundedRectangle(x, y - 3.0f, std::min(width, area.getRight() - x), 6.0f, 3.0f);
+    }
+    
+    paintMetrics(g, area);
+}
+
+void GrainVisualiser::paintMetrics(juce::Graphics& g, juce::Rectangle<float> area)
+{
+    auto& metrics = governor.getMetrics();
+    
+    juce::String text = "CPU " + juce::String(juce::roundToInt(metrics.load * 100)) + "% / "
+                      + juce::String(juce::roundToInt(governor.getMaximumLoad() * 100)) + "%   "
+                      + juce::String(metrics.activeGrains.load()) + " grains";
+    
+    if (metrics.grainLimit > 0)
+    {
+        text << " (limited to " << metrics.grainLimit.load() << ")";
+    }
+    
+    g.setColour (metrics.grainLimit > 0 ? juce::Colours::orange : juce::Colours::white.withAlpha(0.6f));
+    g.setFont(12.0f);
+    g.drawText(text, area.removeFromTop(14.0f), juce::Justification::topRight);
+    
+    if (showStageCosts)
+    {
+        auto stageNames = GrainGovernor::getStageNames();
+        juce::String costs;
+        
+        for (int stage = 0; stage < GrainGovernor::numStages; ++stage)
+        {
+            costs << stageNames[stage] << " " << juce::String(metrics.stageCost[(size_t) stage].load(), 1) << "   ";
+        }
+        
+        g.setColour (juce::Colours::white.withAlpha(0.6f));
+        g.drawText(costs + "ns/sample", area.removeFromTop(14.0f), juce::Justification::topRight);
+    }
+}
+
+void GrainVisualiser::mouseDown(const juce::MouseEvent& event)
+{
+    if (! event.mods.isPopupMenu())
+    {
+        return;
+    }
+    
+    juce::PopupMenu menu;
+    menu.addSectionHeader("CPU limit");
+    
+    for (int percent : { 10, 25, 50, 75, 100 })
+    {
+        float share = percent / 100.0f;
+        menu.addItem(juce::String(percent) + "%", true, std::abs(governor.getMaximumLoad() - share) < 0.001f, [this, share]
+        {
+            governor.setMaximumLoad(share);
+        });
+    }
+    
+    menu.addSeparator();
+    menu.addItem("Show stage costs", true, showStageCosts, [this] { showStageCosts = ! showStageCosts; repaint(); });
+    
+    if (addMenuItems)
+    {
+        addMenuItems(menu);
+    }
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this));
+}
+
+void GrainVisualiser::timerCallback()
+{
+    bool hasChanged = ! activeGrains.empty() || governor.isLimiting() || showStageCosts;
+    
+    grainEvents.popAll([this, &hasChanged] (const GrainEvent& event)
+    {
+        hasChanged = true;
+        
+        switch (event.type)
+        {
+            case GrainEvent::Type::spawned:
+            case GrainEvent::Type::progressed:
+                activeGrains[event.id] = { event.position, event.size, event.pan, event.phase, 0 };
+                break;
+                
+            case GrainEvent::Type::finished:
+                activeGrains.erase(event.id);
+                break;
+                
+            case GrainEvent::Type::waveform:
+                waveform[(size_t) event.id] = event.position;
+                writeColumn = event.id;
+                break;
+        }
+    });
+    
+    // events can be dropped when the queue is full, so forget grains that have gone quiet
+    for (auto grain = activeGrains.begin(); grain != activeGrains.end();)
+    {
+        if (++grain->second.framesSinceUpdate > frameRate)
+        {
+            grain = activeGrains.erase(grain);
+        }
+        else
+        {
+            ++grain;
+        }
+    }
+    
+    if (hasChanged)
+    {
+        repaint();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "GrainProcessor.h"
+
+// Shows the delay buffer and the grains currently reading from it. Events
+// from the engine are drained at a fixed frame rate on the message thread.
+// Right clicking sets the share of the audio callback the engine may use and
+// shows what each stage of the engine costs, along with anything the owner
+// adds through addMenuItems.
+class GrainVisualiser : public juce::Component, private juce::Timer
+{
+public:
+    GrainVisualiser(GrainEventFifo& eventFifo, GrainGovernor& grainGovernor);
+    ~GrainVisualiser() override;
+    
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+    
+    std::function<void(juce::PopupMenu&)> addMenuItems;
+    
+    static constexpr int frameRate = 30;
+    
+private:
+    void timerCallback() override;
+    void paintMetrics(juce::Graphics& g, juce::Rectangle<float> area);
+    
+    struct GrainState
+    {
+        float position;
+        float size;
+        float pan;
+        float phase;
+        int framesSinceUpdate;
+    };
+    
+    GrainEventFifo& grainEvents;
+    GrainGovernor& governor;
+    
+    std::unordered_map<int, GrainState> activeGrains;   // keyed by grain id
+    std::array<float, GrainProcessor::numWaveformColumns> waveform {};
+    int writeColumn = 0;
+    
+    bool showStageCosts = false;
+    
+    int outlineThickness;
+    int curveAmount;
+};
@@ -0,0 +1,266 @@
+#include "GrainWindow.h"
+
+namespace
+{
+    constexpr double tukeyTaper = 0.5;          // fraction of the window spent in the cosine tapers
+    constexpr double gaussianSigma = 0.2;       // standard deviation relative to the window length
+    constexpr float trapezoidRamp = 0.25f;      // fraction of the window spent in each linear ramp
+
+    // sourceStride is 1 when reading forwards and -1 when reading backwards
+    template <int sourceStride, typename SampleType, typename WindowFunction>
+    void mixWithWindow(const SampleType* const* source, float* const* destination, const float* gains, int numChannels,
+                       int offset, int numSamples, double startPhase, double phaseIncrement, WindowFunction windowFunction)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float window = windowFunction((float) (startPhase + i * phaseIncrement));
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                destination[channel][offset + i] += toFloat(source[channel][(offset + i) * sourceStride]) * window * gains[channel];
+            }
+        }
+    }
+
+    template <int sourceStride>
+    void loadFour(const float* source, float* destination)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            destination[lane] = source[lane * sourceStride];
+        }
+    }
+
+    template <int sourceStride>
+    void loadFour(const Float16* source, float* destination)
+    {
+        Float16::loadFour<sourceStride>(source, destination);
+    }
+}
+
+WindowTables::WindowTables()
+{
+    const double gaussianEdge = std::exp(-0.5 * std::pow(0.5 / gaussianSigma, 2));
+
+    for (int i = 0; i <= tableSize; ++i)
+    {
+        double phase = (double) i / tableSize;
+
+        // tukey: cosine tapers on both ends, flat in the middle
+        double distanceFromEdge = std::min(phase, 1.0 - phase);
+        if (distanceFromEdge < tukeyTaper / 2)
+        {
+            tukey[i] = (float) (0.5 * (1 - std::cos(2 * M_PI * distanceFromEdge / tukeyTaper)));
+        }
+        else
+        {
+            tukey[i] = 1.0f;
+        }
+
+        // gaussian, shifted and rescaled so that it reaches zero at the edges
+        double gaussianValue = std::exp(-0.5 * std::pow((phase - 0.5) / gaussianSigma, 2));
+        gaussian[i] = (float) std::max(0.0, (gaussianValue - gaussianEdge) / (1 - gaussianEdge));
+    }
+}
+
+const float* WindowTables::getTable(WindowShape shape) const
+{
+    switch (shape)
+    {
+        case WindowShape::tukey:    return tukey.data();
+        case WindowShape::gaussian: return gaussian.data();
+        default:                    return nullptr;
+    }
+}
+
+GrainWindow::GrainWindow(WindowShape windowShape, double skew, int grainSize, const WindowTables& tables) : shape(windowShape),
+    table(tables.getTable(windowShape)), size(grainSize)
+{
+    // skew moves the peak of the window, 0.5 gives a symmetric window
+    attackLength = juce::jlimit(1, std::max(1, size - 1), (int) (skew * size));
+
+    if (shape == WindowShape::blackman)
+    {
+        cosineWeights[0] = 0.42f;
+        cosineWeights[1] = 0.5f;
+        cosineWeights[2] = 0.08f;
+    }
+
+    startSegment(true);
+}
+
+template <typename SampleType>
+void GrainWindow::mix(const SampleType* const* source, float* const* destination, const float* gains, int numChannels, int numSamples, bool readBackwards)
+{
+    int offset = 0;
+
+    while (offset < numSamples && position < size)
+    {
+        if (position == segmentEnd)
+        {
+            startSegment(false);
+        }
+
+        int spanLength = std::min(numSamples - offset, segmentEnd - position);
+        if (readBackwards)
+        {
+            mixSpan<-1>(source, destination, gains, numChannels, offset, spanLength);
+        }
+        else
+        {
+            mixSpan<1>(source, destination, gains, numChannels, offset, spanLength);
+        }
+
+        position += spanLength;
+        offset += spanLength;
+    }
+}
+
+void GrainWindow::advance(int numSamples)
+{
+    position = std::min(size, position + numSamples);
+
+    if (segmentStart == 0 && position >= attackLength)
+    {
+        startSegment(false);
+    }
+}
+
+juce::StringArray GrainWindow::getShapeNames()
+{
+    return { "Hann", "Tukey", "Gaussian", "Trapezoid", "Welch", "Blackman" };
+}
+
+void GrainWindow::startSegment(bool isAttack)
+{
+    segmentStart = isAttack ? 0 : attackLength;
+    segmentEnd = isAttack ? attackLength : size;
+    segmentStartPhase = isAttack ? 0.0 : 0.5;
+    phaseIncrement = 0.5 / (segmentEnd - segmentStart);
+
+    // lane j starts j samples ahead, every lane then advances by laneCount samples at a time
+    double angleIncrement = 2 * M_PI * phaseIncrement;
+    for (int lane = 0; lane < laneCount; ++lane)
+    {
+        laneRotationCos[lane] = (float) std::cos(lane * angleIncrement);
+        laneRotationSin[lane] = (float) std::sin(lane * angleIncrement);
+    }
+
+    stepRotationCos = (float) std::cos(laneCount * angleIncrement);
+    stepRotationSin = (float) std::sin(laneCount * angleIncrement);
+}
+
+template <int sourceStride, typename SampleType>
+void GrainWindow::mixSpan(const SampleType* const* source, float* const* destination, const float* gains, int numChannels, int offset, int numSamples)
+{
+    double startPhase = segmentStartPhase + (position - segmentStart) * phaseIncrement;
+
+    switch (shape)
+    {
+        case WindowShape::hann:
+        case WindowShape::blackman:
+            mixCosineSpan<sourceStride, SampleType>(source, destination, gains, numChannels, offset, numSamples);
+            break;
+
+        case WindowShape::trapezoid:
+            mixWithWindow<sourceStride>(source, destination, gains, numChannels, offset, numSamples, startPhase, phaseIncrement, [] (float phase)
+            {
+                return std::min(1.0f, std::min(phase, 1.0f - phase) / trapezoidRamp);
+            });
+            break;
+
+        case WindowShape::welch:
+            mixWithWindow<sourceStride>(source, destination, gains, numChannels, offset, numSamples, startPhase, phaseIncrement, [] (float phase)
+            {
+                float centred = 2.0f * phase - 1.0f;
+                return 1.0f - centred * centred;
+            });
+            break;
+
+        case WindowShape::tukey:
+        case WindowShape::gaussian:
+            mixWithWindow<sourceStride>(source, destination, gains, numChannels, offset, numSamples, startPhase, phaseIncrement, [this] (float phase)
+            {
+                return getTableValue(phase);
+            });
+            break;
+    }
+}
+
+template <int sourceStride, typename SampleType>
+void GrainWindow::mixCosineSpan(const SampleType* const* source, float* const* destination, const float* gains, int numChannels, int offset, int numSamples)
+{
+    // seed the phasors from the exact angle once per call so rounding never builds up over a long grain
+    double angle = 2 * M_PI * (segmentStartPhase + (position - segmentStart) * phaseIncrement);
+    float startCos = (float) std::cos(angle);
+    float startSin = (float) std::sin(angle);
+
+    float laneCos[laneCount];
+    float laneSin[laneCount];
+    for (int lane = 0; lane < laneCount; ++lane)
+    {
+        laneCos[lane] = startCos * laneRotationCos[lane] - startSin * laneRotationSin[lane];
+        laneSin[lane] = startSin * laneRotationCos[lane] + startCos * laneRotationSin[lane];
+    }
+
+    float window[laneCount];
+    float samples[laneCount];
+    int i = 0;
+
+    while (i < numSamples)
+    {
+        for (int lane = 0; lane < laneCount; ++lane)
+        {
+            float cos2 = 2.0f * laneCos[lane] * laneCos[lane] - 1.0f;
+            window[lane] = cosineWeights[0] - cosineWeights[1] * laneCos[lane] + cosineWeights[2] * cos2;
+        }
+
+        if (i + laneCount <= numSamples)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                float* output = destination[channel] + offset + i;
+                float gain = gains[channel];
+
+                // a negative stride reads the lanes in reverse, which still vectorises as a load and a shuffle
+                loadFour<sourceStride>(source[channel] + (offset + i) * sourceStride, samples);
+
+                for (int lane = 0; lane < laneCount; ++lane)
+                {
+                    output[lane] += samples[lane] * window[lane] * gain;
+                }
+            }
+        }
+        else
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                for (int lane = 0; lane < numSamples - i; ++lane)
+                {
+                    destination[channel][offset + i + lane] += toFloat(source[channel][(offset + i + lane) * sourceStride]) * window[lane] * gains[channel];
+                }
+            }
+        }
+
+        for (int lane = 0; lane < laneCount; ++lane)
+        {
+            float nextSin = laneSin[lane] * stepRotationCos + laneCos[lane] * stepRotationSin;
+            laneCos[lane] = laneCos[lane] * stepRotationCos - laneSin[lane] * stepRotationSin;
+            laneSin[lane] = nextSin;
+        }
+
+        i += laneCount;
+    }
+}
+
+float GrainWindow::getTableValue(float phase) const
+{
+    float tablePosition = juce::jlimit(0.0f, 1.0f, phase) * WindowTables::tableSize;
+    int index = std::min((int) tablePosition, WindowTables::tableSize - 1);
+    float fraction = tablePosition - index;
+
+    return table[index] + fraction * (table[index + 1] - table[index]);
+}
+
+template void GrainWindow::mix<float>(const float* const*, float* const*, const float*, int, int, bool);
+template void GrainWindow::mix<Float16>(const Float16* const*, float* const*, const float*, int, int, bool);
@@ -0,0 +1,76 @@
+#pragma once
+#include <JuceHeader.h>
+#include "Float16.h"
+
+enum class WindowShape
+{
+    hann = 0,
+    tukey,
+    gaussian,
+    trapezoid,
+    welch,
+    blackman
+};
+
+// Tables for the shapes that are too expensive to evaluate per sample.
+// Shared between all plugin instances through a juce::SharedResourcePointer.
+struct WindowTables
+{
+    WindowTables();
+
+    const float* getTable(WindowShape shape) const;
+
+    static constexpr int tableSize = 4096;
+
+    std::array<float, tableSize + 1> tukey;
+    std::array<float, tableSize + 1> gaussian;
+};
+
+class GrainWindow
+{
+public:
+    GrainWindow() = default;
+    GrainWindow(WindowShape windowShape, double skew, int grainSize, const WindowTables& tables);
+
+    // adds the next numSamples of source into destination, weighted by the window and a gain per channel,
+    // when reading backwards source points at the first sample to read and the rest come before it,
+    // source can be float or Float16 samples, which are widened as they are read
+    template <typename SampleType>
+    void mix(const SampleType* const* source, float* const* destination, const float* gains, int numChannels, int numSamples, bool readBackwards = false);
+
+    // moves through the window without mixing anything, for stretches that would be inaudible
+    void advance(int numSamples);
+
+    static juce::StringArray getShapeNames();
+
+private:
+    void startSegment(bool isAttack);
+    template <int sourceStride, typename SampleType>
+    void mixSpan(const SampleType* const* source, float* const* destination, const float* gains, int numChannels, int offset, int numSamples);
+    template <int sourceStride, typename SampleType>
+    void mixCosineSpan(const SampleType* const* source, float* const* destination, const float* gains, int numChannels, int offset, int numSamples);
+
+    float getTableValue(float phase) const;
+
+    static constexpr int laneCount = 4;     // matches one load of four samples, see Float16::loadFour
+
+    WindowShape shape = WindowShape::hann;
+    const float* table = nullptr;
+
+    int size = 0;
+    int attackLength = 0;   // samples from the start of the grain to the peak of the window
+    int position = 0;
+
+    // the attack covers the first half of the shape and the release the second half
+    int segmentStart = 0;
+    int segmentEnd = 0;
+    double segmentStartPhase = 0.0;
+    double phaseIncrement = 0.0;
+
+    // sum of cosines shapes, a0 - a1 cos(x) + a2 cos(2x), generated by rotating one phasor per lane
+    float cosineWeights[3] = { 0.5f, 0.5f, 0.0f };
+    float laneRotationCos[laneCount] = {};
+    float laneRotationSin[laneCount] = {};
+    float stepRotationCos = 1.0f;
+    float stepRotationSin = 0.0f;
+};
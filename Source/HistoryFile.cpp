@@ -0,0 +1,180 @@
+#include "HistoryFile.h"
+
+HistoryFile::HistoryFile(int channelCount, int lengthInSamples) : juce::Thread("Shatter history writer"),
+    numChannels(channelCount), length(lengthInSamples)
+{
+    auto numBytes = (juce::int64) numChannels * length * (juce::int64) sizeof(float);
+    file = juce::File::getSpecialLocation(juce::File::tempDirectory).getNonexistentChildFile("ShatterHistory", ".raw");
+    
+    // sized by writing its last byte, most file systems leave the rest sparse until it's recorded over
+    {
+        juce::FileOutputStream stream(file);
+        
+        if (stream.failedToOpen() || ! stream.setPosition(numBytes - 1) || ! stream.writeByte(0))
+        {
+            return;
+        }
+    }
+    
+    mapping = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readWrite, true);
+    
+    if (mapping->getData() == nullptr || (juce::int64) mapping->getSize() < numBytes)
+    {
+        mapping.reset();
+        return;
+    }
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        channels.push_back(static_cast<float*>(mapping->getData()) + (size_t) channel * (size_t) length);
+    }
+    
+    int fifoSize = fifoSeconds * 192000;
+    fifo.setTotalSize(fifoSize);
+    fifoBuffer.setSize(numChannels, fifoSize);
+    
+    startThread();
+}
+
+HistoryFile::~HistoryFile()
+{
+    stopThread(4000);
+    
+    channels.clear();
+    mapping.reset();
+    file.deleteFile();
+}
+
+bool HistoryFile::isValid() const                           { return mapping != nullptr; }
+juce::int64 HistoryFile::getNumFramesPushed() const         { return framesPushed; }
+juce::int64 HistoryFile::getNumFramesRecorded() const       { return framesRecorded; }
+const float* const* HistoryFile::getChannels() const        { return channels.data(); }
+int HistoryFile::getLength() const                          { return length; }
+
+void HistoryFile::push(const float* const* source, int numSourceChannels, int numSamples)
+{
+    framesPushed += numSamples;
+    
+    // after a drop nothing more goes in until the writer has caught up and stepped over the gap
+    if (fifo.getFreeSpace() < numSamples || (droppedFrames > 0 && fifo.getNumReady() > 0))
+    {
+        droppedFrames += numSamples;
+        return;
+    }
+    
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+    
+    for (int channel = 0; channel < numChannels; ++channel)
+    {
+        if (channel < numSourceChannels)
+        {
+            fifoBuffer.copyFrom(channel, start1, source[channel], size1);
+            fifoBuffer.copyFrom(channel, start2, source[channel] + size1, size2);
+        }
+        else
+        {
+            fifoBuffer.clear(channel, start1, size1);
+            fifoBuffer.clear(channel, start2, size2);
+        }
+    }
+    
+    fifo.finishedWrite(size1 + size2);
+}
+
+juce::int64 HistoryFile::prefetch(int startSample, int numSamples)
+{
+    jassert(startSample >= 0 && startSample < length);
+    
+    if (numSamples <= 0 || prefetchFifo.getFreeSpace() == 0)
+    {
+        return -1;
+    }
+    
+    int start1, size1, start2, size2;
+    prefetchFifo.prepareToWrite(1, start1, size1, start2, size2);
+    prefetchRanges[(size_t) start1] = { startSample, numSamples };
+    prefetchFifo.finishedWrite(1);
+    
+    return prefetchesRequested++;
+}
+
+bool HistoryFile::isPrefetched(juce::int64 ticket) const
+{
+    // requests are served in order, so every ticket below the count is done
+    return ticket >= 0 && ticket < prefetchesCompleted;
+}
+
+void HistoryFile::run()
+{
+    // polled rather than signalled, waking a thread isn't safe from the audio thread
+    while (! threadShouldExit())
+    {
+        prefetchPendingRanges();
+        writePendingFrames();
+        
+        wait(5);
+    }
+}
+
+void HistoryFile::writePendingFrames()
+{
+    int numReady = fifo.getNumReady();
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(numReady, start1, size1, start2, size2);
+    
+    for (auto [start, size] : { std::pair<int, int> { start1, size1 }, std::pair<int, int> { start2, size2 } })
+    {
+        int done = 0;
+        
+        while (done < size)
+        {
+            int filePosition = (int) (writePosition % length);
+            int runLength = std::min(size - done, length - filePosition);
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                std::memcpy(channels[(size_t) channel] + filePosition, fifoBuffer.getReadPointer(channel, start + done), (size_t) runLength * sizeof(float));
+            }
+            
+            writePosition += runLength;
+            done += runLength;
+        }
+    }
+    
+    fifo.finishedRead(size1 + size2);
+    
+    // frames the FIFO had no room for are skipped in the file too, so positions keep lining up with time
+    writePosition += droppedFrames.exchange(0);
+    framesRecorded = writePosition;
+}
+
+void HistoryFile::prefetchPendingRanges()
+{
+    int start1, size1, start2, size2;
+    prefetchFifo.prepareToRead(prefetchFifo.getNumReady(), start1, size1, start2, size2);
+    
+    // reading one sample per page is enough to fault it in here instead of on the audio thread
+    constexpr int samplesPerPage = 4096 / (int) sizeof(float);
+    float sum = 0.0f;
+    
+    auto touch = [this, &sum] (const PrefetchRange& range)
+    {
+        for (int offset = 0; offset < range.numSamples + samplesPerPage; offset += samplesPerPage)
+        {
+            int position = (range.start + std::min(offset, range.numSamples - 1)) % length;
+            
+            for (auto* channel : channels)
+            {
+                sum += channel[position];
+            }
+        }
+    };
+    
+    for (int i = 0; i < size1; ++i)     { touch(prefetchRanges[(size_t) (start1 + i)]); }
+    for (int i = 0; i < size2; ++i)     { touch(prefetchRanges[(size_t) (start2 + i)]); }
+    
+    prefetchFifo.finishedRead(size1 + size2);
+    prefetchSink = sum;
+    prefetchesCompleted += size1 + size2;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Minutes of input recorded to a memory mapped ring file in the temp folder.
+// The audio thread hands blocks over through a lock-free FIFO and a
+// background thread copies them into the mapping. The audio thread only
+// reads a stretch of the mapping once the background thread has faulted its
+// pages in, so a cold page costs the grain a few milliseconds of delay instead
+// of disk I/O in the audio callback.
+class HistoryFile : private juce::Thread
+{
+public:
+    HistoryFile(int numChannels, int lengthInSamples);
+    ~HistoryFile() override;
+    
+    // false when the file couldn't be created or mapped
+    bool isValid() const;
+    
+    // audio thread, blocks that don't fit in the FIFO are dropped
+    void push(const float* const* channels, int numChannels, int numSamples);
+    
+    // audio thread, asks for the pages under a stretch of the ring to be brought in ahead of a grain reading it,
+    // returns a ticket for isPrefetched, or -1 when too many requests are waiting
+    juce::int64 prefetch(int startSample, int numSamples);
+    
+    // audio thread, true once the background thread has touched every page of the request
+    bool isPrefetched(juce::int64 ticket) const;
+    
+    // frames pushed by the audio thread so far, and how many of them are in the file
+    juce::int64 getNumFramesPushed() const;
+    juce::int64 getNumFramesRecorded() const;
+    
+    const float* const* getChannels() const;
+    int getLength() const;
+    
+private:
+    void run() override;
+    void writePendingFrames();
+    void prefetchPendingRanges();
+    
+    int numChannels;
+    int length;
+    
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    std::vector<float*> channels;
+    
+    // audio thread to background thread
+    static constexpr int fifoSeconds = 2;
+    juce::AbstractFifo fifo { 1 };
+    juce::AudioBuffer<float> fifoBuffer;
+    
+    struct PrefetchRange
+    {
+        int start;
+        int numSamples;
+    };
+    
+    static constexpr int maxPrefetchRanges = 256;
+    juce::AbstractFifo prefetchFifo { maxPrefetchRanges };
+    std::array<PrefetchRange, maxPrefetchRanges> prefetchRanges;
+    juce::int64 prefetchesRequested = 0;            // audio thread only
+    std::atomic<juce::int64> prefetchesCompleted { 0 };
+    
+    juce::int64 framesPushed = 0;                   // audio thread only
+    std::atomic<juce::int64> framesRecorded { 0 };
+    std::atomic<int> droppedFrames { 0 };
+    juce::int64 writePosition = 0;                  // background thread only
+    
+    volatile float prefetchSink = 0.0f;
+};
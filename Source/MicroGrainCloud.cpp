@@ -0,0 +1,124 @@
+#include "MicroGrainCloud.h"
+
+namespace
+{
+    template <typename SampleType>
+    void mixRun(const SampleType* source, float* destination, float gain, float phase, float phaseIncrement, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            float position = phase + i * phaseIncrement;
+            float window = 4.0f * position * (1.0f - position);
+
+            destination[i] += toFloat(source[i]) * window * window * gain;
+        }
+    }
+}
+
+void MicroGrainCloud::prepare()
+{
+    numActive = 0;
+
+    for (auto* values : { &readPositions, &startOffsets, &samplesRemaining })
+    {
+        values->assign(capacity, 0);
+    }
+
+    for (auto* values : { &phases, &phaseIncrements, &gains[0], &gains[1] })
+    {
+        values->assign(capacity, 0.0f);
+    }
+}
+
+void MicroGrainCloud::release()
+{
+    numActive = 0;
+
+    for (auto* values : { &readPositions, &startOffsets, &samplesRemaining })
+    {
+        std::vector<int>().swap(*values);
+    }
+
+    for (auto* values : { &phases, &phaseIncrements, &gains[0], &gains[1] })
+    {
+        std::vector<float>().swap(*values);
+    }
+}
+
+void MicroGrainCloud::clear()               { numActive = 0; }
+int MicroGrainCloud::getNumActive() const   { return numActive; }
+
+bool MicroGrainCloud::add(int startPosition, int startOffset, int length, float panning)
+{
+    if (numActive >= (int) readPositions.size() || length <= 0)
+    {
+        return false;
+    }
+
+    auto grain = (size_t) numActive++;
+    readPositions[grain] = startPosition;
+    startOffsets[grain] = startOffset;
+    samplesRemaining[grain] = length;
+    phases[grain] = 0.0f;
+    phaseIncrements[grain] = 1.0f / length;
+
+    // same law as the long grains, the far side is turned down and the near side left alone
+    gains[0][grain] = panning > 0.0f ? 1.0f - panning : 1.0f;
+    gains[1][grain] = panning < 0.0f ? 1.0f + panning : 1.0f;
+
+    return true;
+}
+
+template <typename SampleType>
+void MicroGrainCloud::mix(const SampleType* const* ringBuffer, int ringBufferSize, float* const* destination, int numChannels, int numSamples)
+{
+    int grain = 0;
+
+    while (grain < numActive)
+    {
+        auto index = (size_t) grain;
+        int offset = startOffsets[index];
+        int amountToMix = std::min(samplesRemaining[index], numSamples - offset);
+        int position = readPositions[index];
+        float phase = phases[index];
+        int done = 0;
+
+        // at most two runs either side of the wraparound
+        while (done < amountToMix)
+        {
+            int runLength = std::min(amountToMix - done, ringBufferSize - position);
+
+            for (int channel = 0; channel < std::min(numChannels, 2); ++channel)
+            {
+                mixRun(ringBuffer[channel] + position, destination[channel] + offset + done, gains[channel][index], phase, phaseIncrements[index], runLength);
+            }
+
+            phase += runLength * phaseIncrements[index];
+            position = (position + runLength) % ringBufferSize;
+            done += runLength;
+        }
+
+        samplesRemaining[index] -= amountToMix;
+
+        if (samplesRemaining[index] <= 0)
+        {
+            auto last = (size_t) --numActive;
+            readPositions[index] = readPositions[last];
+            startOffsets[index] = startOffsets[last];
+            samplesRemaining[index] = samplesRemaining[last];
+            phases[index] = phases[last];
+            phaseIncrements[index] = phaseIncrements[last];
+            gains[0][index] = gains[0][last];
+            gains[1][index] = gains[1][last];
+            continue;
+        }
+
+        readPositions[index] = position;
+        startOffsets[index] = 0;
+        phases[index] = phase;
+        ++grain;
+    }
+}
+
+template void MicroGrainCloud::mix<float>(const float* const*, int, float* const*, int, int);
+template void MicroGrainCloud::mix<Float16>(const Float16* const*, int, float* const*, int, int);
@@ -0,0 +1,37 @@
+#pragma once
+#include <JuceHeader.h>
+#include "Float16.h"
+
+// Grains of a few milliseconds at up to thousands a second, kept as parallel
+// arrays instead of Grain objects. The window is analytic, (4p(1 - p))^2,
+// close to a Hann window with nothing to set up per grain. Each grain is
+// mixed along its samples, where the reads are contiguous and the loop
+// vectorises, and finished grains are swapped out with the last one.
+class MicroGrainCloud
+{
+public:
+    void prepare();
+    void release();
+    void clear();
+
+    // false when the cloud is full
+    bool add(int startPosition, int startOffset, int length, float panning);
+
+    // adds the next numSamples of every grain into destination, the ring buffer's channels can hold float or Float16 samples
+    template <typename SampleType>
+    void mix(const SampleType* const* ringBuffer, int ringBufferSize, float* const* destination, int numChannels, int numSamples);
+
+    int getNumActive() const;
+
+    static constexpr int capacity = 1024;
+
+private:
+    int numActive = 0;
+
+    std::vector<int> readPositions;
+    std::vector<int> startOffsets;      // into the block, for grains that haven't started yet
+    std::vector<int> samplesRemaining;
+    std::vector<float> phases;
+    std::vector<float> phaseIncrements;
+    std::vector<float> gains[2];        // left and right, from the panning
+};
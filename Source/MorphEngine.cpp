@@ -0,0 +1,139 @@
+#include "MorphEngine.h"
+
+void MorphEngine::setSlot(int slot, const ParameterSnapshot& snapshot)
+{
+    jassert(juce::isPositiveAndBelow(slot, numSlots));
+
+    slots.snapshots[(size_t) slot] = snapshot;
+    slots.isFilled[(size_t) slot] = true;
+    publishSlots();
+}
+
+void MorphEngine::clearSlot(int slot)
+{
+    jassert(juce::isPositiveAndBelow(slot, numSlots));
+
+    slots.isFilled[(size_t) slot] = false;
+    publishSlots();
+}
+
+bool MorphEngine::isSlotFilled(int slot) const
+{
+    return juce::isPositiveAndBelow(slot, numSlots) && slots.isFilled[(size_t) slot];
+}
+
+int MorphEngine::getNumFilledSlots() const
+{
+    return (int) std::count(slots.isFilled.begin(), slots.isFilled.end(), true);
+}
+
+void MorphEngine::excludeParameter(int parameterIndex)
+{
+    if (juce::isPositiveAndBelow(parameterIndex, ParameterSnapshot::maxParameters))
+    {
+        isExcluded[(size_t) parameterIndex] = true;
+    }
+}
+
+void MorphEngine::writeSlots(juce::OutputStream& stream, const juce::Array<juce::AudioProcessorParameter*>& parameters) const
+{
+    stream.writeInt(numSlots);
+
+    for (int slot = 0; slot < numSlots; ++slot)
+    {
+        stream.writeBool(slots.isFilled[(size_t) slot]);
+
+        if (slots.isFilled[(size_t) slot])
+        {
+            slots.snapshots[(size_t) slot].write(stream, parameters);
+        }
+    }
+}
+
+void MorphEngine::readSlots(juce::InputStream& stream, juce::AudioProcessorValueTreeState& valueTreeState)
+{
+    int numStoredSlots = stream.readInt();
+
+    for (int slot = 0; slot < numStoredSlots && ! stream.isExhausted(); ++slot)
+    {
+        bool isFilled = stream.readBool();
+        ParameterSnapshot snapshot;
+
+        if (isFilled)
+        {
+            snapshot.read(stream, valueTreeState);
+        }
+
+        if (slot < numSlots)
+        {
+            slots.snapshots[(size_t) slot] = snapshot;
+            slots.isFilled[(size_t) slot] = isFilled;
+        }
+    }
+
+    publishSlots();
+}
+
+void MorphEngine::process(ParameterSnapshot& parameters, float x, float y)
+{
+    audioSlots.update();
+    auto& currentSlots = audioSlots.getReadBuffer();
+
+    // bilinear weights, renormalised over the corners that hold a snapshot
+    float weights[numSlots] = { (1 - x) * (1 - y), x * (1 - y), (1 - x) * y, x * y };
+    float totalWeight = 0.0f;
+    int numFilled = 0;
+
+    for (int slot = 0; slot < numSlots; ++slot)
+    {
+        if (! currentSlots.isFilled[(size_t) slot])
+        {
+            weights[slot] = 0.0f;
+        }
+
+        totalWeight += weights[slot];
+        numFilled += currentSlots.isFilled[(size_t) slot] ? 1 : 0;
+    }
+
+    if (numFilled < 2)
+    {
+        return;
+    }
+
+    // sitting on an empty corner gives every stored snapshot the same share
+    if (totalWeight <= 0.0f)
+    {
+        for (int slot = 0; slot < numSlots; ++slot)
+        {
+            weights[slot] = currentSlots.isFilled[(size_t) slot] ? 1.0f : 0.0f;
+        }
+
+        totalWeight = (float) numFilled;
+    }
+
+    for (int i = 0; i < parameters.numValues; ++i)
+    {
+        if (isExcluded[(size_t) i])
+        {
+            continue;
+        }
+
+        float value = 0.0f;
+
+        for (int slot = 0; slot < numSlots; ++slot)
+        {
+            if (weights[slot] > 0.0f)
+            {
+                value += weights[slot] * currentSlots.snapshots[(size_t) slot].values[(size_t) i];
+            }
+        }
+
+        parameters.values[(size_t) i] = value / totalWeight;
+    }
+}
+
+void MorphEngine::publishSlots()
+{
+    audioSlots.getWriteBuffer() = slots;
+    audioSlots.publish();
+}
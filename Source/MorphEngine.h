@@ -0,0 +1,40 @@
+#pragma once
+#include <JuceHeader.h>
+#include "PresetBank.h"
+#include "TripleBuffer.h"
+
+// Blends up to four stored snapshots, one per corner of the XY pad:
+// A bottom left, B bottom right, C top left, D top right.
+class MorphEngine
+{
+public:
+    static constexpr int numSlots = 4;
+
+    // message thread
+    void setSlot(int slot, const ParameterSnapshot& snapshot);
+    void clearSlot(int slot);
+    bool isSlotFilled(int slot) const;
+    int getNumFilledSlots() const;
+
+    // parameters that keep their own value while morphing, such as the pad position itself
+    void excludeParameter(int parameterIndex);
+
+    void writeSlots(juce::OutputStream& stream, const juce::Array<juce::AudioProcessorParameter*>& parameters) const;
+    void readSlots(juce::InputStream& stream, juce::AudioProcessorValueTreeState& valueTreeState);
+
+    // audio thread: replaces the values in parameters with the blend at x, y (both 0 to 1)
+    void process(ParameterSnapshot& parameters, float x, float y);
+
+private:
+    struct Slots
+    {
+        std::array<ParameterSnapshot, numSlots> snapshots;
+        std::array<bool, numSlots> isFilled {};
+    };
+
+    void publishSlots();
+
+    Slots slots;
+    TripleBuffer<Slots> audioSlots;
+    std::array<bool, ParameterSnapshot::maxParameters> isExcluded {};
+};
@@ -11,48 +11,304 @@
 
 //==============================================================================
 ShatterAudioProcessorEditor::ShatterAudioProcessorEditor (ShatterAudioProcessor& p)
-    : AudioProcessorEditor(&p), audioProcessor(p), sizeKnobs("Size", 1.0, "SIZE", "Random", 1.0, "SIZERANDOM", p.apvts, this), densityKnobs("Density", 1.0, "DENSITY", "Random", 1.0, "DENSITYRANDOM", p.apvts, this), widthAndSpreadKnobs("Width", 1.0, "WIDTH", "Spread", 0.3, "SPREAD", p.apvts, this)
+    : AudioProcessorEditor(&p), audioProcessor(p), backgroundLoader(p.getBackgroundLoader()), sizeKnobs("Size", 1.0, "SIZE", "Random", 1.0, "SIZERANDOM", p.apvts, this), densityKnobs("Density", 1.0, "DENSITY", "Random", 1.0, "DENSITYRANDOM", p.apvts, this), widthAndSpreadKnobs("Width", 1.0, "WIDTH", "Spread", 0.3, "SPREAD", p.apvts, this), windowKnobs("Window", 1.0, "SHAPE", "Skew", 1.0, "SKEW", p.apvts, this), grainVisualiser(p.grainMill->getGrainEvents(), p.grainMill->getGovernor()), morphPad(p.apvts, "MORPHX", "MORPHY")
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
+    // the background is decoded in the background, a gradient stands in for it until then
+    // twice the default size is enough for high density displays
+    backgroundLoader.load(defaultWidth * 2, defaultHeight * 2);
+    background = backgroundLoader.getImage();
+    backgroundLoader.addChangeListener(this);
+    
+    setOpaque(true);
     setResizable(true, true);
-    setSize (800, 450);
+    setSize (defaultWidth, defaultHeight);
     
     addAndMakeVisible(sizeKnobs);
     addAndMakeVisible(densityKnobs);
     addAndMakeVisible(widthAndSpreadKnobs);
+    addAndMakeVisible(windowKnobs);
+    addAndMakeVisible(grainVisualiser);
+    grainVisualiser.addMenuItems = [this] (juce::PopupMenu& menu)
+    {
+        auto storage = audioProcessor.getDelayStorage();
+        
+        menu.addSectionHeader("Delay buffer");
+        menu.addItem("32-bit float", true, storage == DelayStorage::float32, [this] { audioProcessor.setDelayStorage(DelayStorage::float32); });
+        menu.addItem("16-bit float, half the memory", true, storage == DelayStorage::float16, [this] { audioProcessor.setDelayStorage(DelayStorage::float16); });
+        
+        auto history = audioProcessor.getLongHistory();
+        
+        menu.addSectionHeader("Long history");
+        menu.addItem("Off", true, history == 0.0, [this] { audioProcessor.setLongHistory(0.0); });
+        
+        for (int minutes : { 1, 10, 60 })
+        {
+            menu.addItem(juce::String(minutes) + " min", true, history == minutes * 60.0, [this, minutes] { audioProcessor.setLongHistory(minutes * 60.0); });
+        }
+        
+        auto morphTime = audioProcessor.getPresetMorphTime();
+        
+        menu.addSectionHeader("Program change");
+        menu.addItem("Switch instantly", true, morphTime == 0.0f, [this] { audioProcessor.setPresetMorphTime(0.0f); });
+        
+        for (float seconds : { 0.25f, 0.5f, 1.0f, 2.0f })
+        {
+            menu.addItem("Morph over " + juce::String(seconds) + " s", true, morphTime == seconds, [this, seconds] { audioProcessor.setPresetMorphTime(seconds); });
+        }
+        
+       #if SHATTER_ENABLE_TRACING
+        menu.addSeparator();
+        menu.addItem("Save trace to desktop", []
+        {
+            Trace::writeChromeTrace(juce::File::getSpecialLocation(juce::File::userDesktopDirectory).getNonexistentChildFile("Shatter trace", ".json"));
+        });
+       #endif
+    };
+    
+    addAndMakeVisible(morphPad);
+    morphPad.isCornerFilled = [this] (int corner) { return audioProcessor.isMorphSlotFilled(corner); };
+    morphPad.onCornerMenuRequested = [this] (int corner) { showMorphCornerMenu(corner); };
+    
+    addAndMakeVisible(morphButton);
+    morphButton.setButtonText("Morph");
+    morphButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+    morphButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "MORPH", morphButton);
+    
+    // items have to be in place before the attachment selects one
+    addAndMakeVisible(placementBox);
+    placementBox.addItemList(AmplitudeIndex::getPlacementNames(), 1);
+    placementAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(p.apvts, "PLACEMENT", placementBox);
+    
+    addAndMakeVisible(zeroSnapButton);
+    zeroSnapButton.setButtonText("Zero snap");
+    zeroSnapButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+    zeroSnapAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "ZEROSNAP", zeroSnapButton);
+    
+    addAndMakeVisible(reverseSlider);
+    reverseSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    reverseSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    reverseAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "REVERSE", reverseSlider);
+    
+    addAndMakeVisible(reverseLabel);
+    reverseLabel.setText("Reverse", juce::dontSendNotification);
+    reverseLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    reverseLabel.attachToComponent(&reverseSlider, true);
+    
+    addAndMakeVisible(feedbackSlider);
+    feedbackSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    feedbackSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    feedbackAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "FEEDBACK", feedbackSlider);
+    
+    addAndMakeVisible(feedbackLabel);
+    feedbackLabel.setText("Feedback", juce::dontSendNotification);
+    feedbackLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    feedbackLabel.attachToComponent(&feedbackSlider, true);
+    
+    addAndMakeVisible(ageSlider);
+    ageSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    ageSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    ageAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "AGE", ageSlider);
+    
+    addAndMakeVisible(ageLabel);
+    ageLabel.setText("Age", juce::dontSendNotification);
+    ageLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    ageLabel.attachToComponent(&ageSlider, true);
+    
+    addAndMakeVisible(microButton);
+    microButton.setButtonText("Micro");
+    microButton.setColour(juce::ToggleButton::textColourId, juce::Colours::white);
+    microButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "MICRO", microButton);
+    
+    addAndMakeVisible(microSizeSlider);
+    microSizeSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    microSizeSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    microSizeAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "MICROSIZE", microSizeSlider);
+    
+    addAndMakeVisible(microSizeLabel);
+    microSizeLabel.setText("Micro size", juce::dontSendNotification);
+    microSizeLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    microSizeLabel.attachToComponent(&microSizeSlider, true);
+    
+    addAndMakeVisible(microRateSlider);
+    microRateSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    microRateSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    microRateAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "MICRORATE", microRateSlider);
+    
+    addAndMakeVisible(microRateLabel);
+    microRateLabel.setText("Micro rate", juce::dontSendNotification);
+    microRateLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    microRateLabel.attachToComponent(&microRateSlider, true);
+    
+    addAndMakeVisible(filterBox);
+    filterBox.addItemList(GrainFilterBank::getModeNames(), 1);
+    filterAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(p.apvts, "FILTER", filterBox);
+    
+    addAndMakeVisible(cutoffSlider);
+    cutoffSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    cutoffSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    cutoffAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "CUTOFF", cutoffSlider);
+    
+    addAndMakeVisible(cutoffLabel);
+    cutoffLabel.setText("Cutoff", juce::dontSendNotification);
+    cutoffLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    cutoffLabel.attachToComponent(&cutoffSlider, true);
+    
+    addAndMakeVisible(resonanceSlider);
+    resonanceSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    resonanceSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    resonanceAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "RESONANCE", resonanceSlider);
+    
+    addAndMakeVisible(resonanceLabel);
+    resonanceLabel.setText("Q", juce::dontSendNotification);
+    resonanceLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    resonanceLabel.attachToComponent(&resonanceSlider, true);
+    
+    addAndMakeVisible(filterSpreadSlider);
+    filterSpreadSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    filterSpreadSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    filterSpreadAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "FILTERSPREAD", filterSpreadSlider);
+    
+    addAndMakeVisible(filterSpreadLabel);
+    filterSpreadLabel.setText("Filter spread", juce::dontSendNotification);
+    filterSpreadLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    filterSpreadLabel.attachToComponent(&filterSpreadSlider, true);
+    
+    addAndMakeVisible(mixSlider);
+    mixSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    mixSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    mixAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "MIX", mixSlider);
+    
+    addAndMakeVisible(mixLabel);
+    mixLabel.setText("Mix", juce::dontSendNotification);
+    mixLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    mixLabel.attachToComponent(&mixSlider, true);
+    
+    addAndMakeVisible(gainSlider);
+    gainSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    gainSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    gainSlider.setDoubleClickReturnValue(true, 0.0);
+    gainAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "GAIN", gainSlider);
+    
+    addAndMakeVisible(gainLabel);
+    gainLabel.setText("Gain", juce::dontSendNotification);
+    gainLabel.setColour(juce::Label::textColourId, juce::Colours::white);
+    gainLabel.attachToComponent(&gainSlider, true);
         
 }
 
 ShatterAudioProcessorEditor::~ShatterAudioProcessorEditor()
 {
+    backgroundLoader.removeChangeListener(this);
 }
 
 //==============================================================================
 
 void ShatterAudioProcessorEditor::paint (juce::Graphics& g)
 {
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
-    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+    // the display scale can change without a resize, e.g. when the window moves to another screen
+    if (juce::Component::getApproximateScaleFactorForComponent(this) != scaledBackgroundScale)
+    {
+        updateBackgroundCache();
+    }
     
-    g.drawImage(background, getLocalBounds().toFloat());
+    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    if (scaledBackground.isValid())
+    {
+        g.drawImage(scaledBackground, getLocalBounds().toFloat());
+    }
+    else
+    {
+        g.setGradientFill(juce::ColourGradient(juce::Colours::darkslategrey, 0.0f, 0.0f, juce::Colours::black, 0.0f, (float) getHeight(), false));
+        g.fillAll();
+    }
+}
+
+void ShatterAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadcaster*)
+{
+    background = backgroundLoader.getImage();
+    updateBackgroundCache();
+    repaint();
+}
 
+void ShatterAudioProcessorEditor::updateBackgroundCache()
+{
+    scaledBackgroundScale = juce::Component::getApproximateScaleFactorForComponent(this);
+    
+    int scaledWidth = juce::roundToInt(getWidth() * scaledBackgroundScale);
+    int scaledHeight = juce::roundToInt(getHeight() * scaledBackgroundScale);
+    
+    if (scaledWidth <= 0 || scaledHeight <= 0 || ! background.isValid())
+    {
+        scaledBackground = {};
+        return;
+    }
+    
+    scaledBackground = juce::Image(juce::Image::RGB, scaledWidth, scaledHeight, false);
+    
+    juce::Graphics g(scaledBackground);
+    g.setImageResamplingQuality(juce::Graphics::highResamplingQuality);
+    // cropped rather than squashed when the editor's proportions differ from the image's
+    g.drawImage(background, scaledBackground.getBounds().toFloat(), juce::RectanglePlacement::fillDestination);
 }
 
 void ShatterAudioProcessorEditor::resized()
 {
+    updateBackgroundCache();
+    
     juce::Rectangle<int> localBounds = getLocalBounds();
+    grainVisualiser.setBounds(localBounds.removeFromBottom(localBounds.getHeight() / 5).reduced(localBounds.getWidth() / 40, localBounds.getHeight() / 80));
+    juce::Rectangle<int> morphArea(localBounds.removeFromRight(localBounds.getWidth() / 5));
     int height = localBounds.getHeight();
     int width = localBounds.getWidth();
     
     juce::Rectangle<int> top(localBounds.removeFromTop(height / 2));
     juce::Rectangle<int> topLeft(top.removeFromLeft(width / 2));
+    juce::Rectangle<int> bottomLeft(localBounds.removeFromLeft(width / 2));
 
     sizeKnobs.setBounds(topLeft.reduced(top.getHeight() / 8));
     densityKnobs.setBounds(top.reduced(top.getHeight() / 8));
-    widthAndSpreadKnobs.setBounds(localBounds.reduced((width - sizeKnobs.getWidth()) / 2, (height / 2 - sizeKnobs.getHeight()) / 2));
+    widthAndSpreadKnobs.setBounds(bottomLeft.reduced(localBounds.getHeight() / 8));
+    windowKnobs.setBounds(localBounds.reduced(localBounds.getHeight() / 8));
+    
+    morphArea.reduce(morphArea.getWidth() / 10, height / 16);
+    juce::Rectangle<int> placementArea(morphArea.removeFromTop(24));
+    zeroSnapButton.setBounds(placementArea.removeFromRight(placementArea.getWidth() / 3));
+    placementBox.setBounds(placementArea);
+    reverseSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    feedbackSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    ageSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    microSizeSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    microRateSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    filterBox.setBounds(morphArea.removeFromTop(24));
+    cutoffSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    resonanceSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    filterSpreadSlider.setBounds(morphArea.removeFromTop(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    gainSlider.setBounds(morphArea.removeFromBottom(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    mixSlider.setBounds(morphArea.removeFromBottom(24).withTrimmedLeft(morphArea.getWidth() / 3));
+    juce::Rectangle<int> toggleArea(morphArea.removeFromBottom(24));
+    microButton.setBounds(toggleArea.removeFromRight(toggleArea.getWidth() / 2));
+    morphButton.setBounds(toggleArea);
+    morphPad.setBounds(morphArea.withSizeKeepingCentre(morphArea.getWidth(), std::min(morphArea.getWidth(), morphArea.getHeight())));
 }
 
 void ShatterAudioProcessorEditor::sliderValueChanged(juce::Slider* slider)
 {
 }
+
+void ShatterAudioProcessorEditor::showMorphCornerMenu(int corner)
+{
+    juce::PopupMenu presetMenu;
+    for (int i = 0; i < audioProcessor.getNumPrograms(); ++i)
+    {
+        presetMenu.addItem(audioProcessor.getProgramName(i), [this, corner, i] { audioProcessor.loadPresetIntoMorphSlot(corner, i); morphPad.repaint(); });
+    }
+    
+    juce::PopupMenu menu;
+    menu.addItem("Store current settings", [this, corner] { audioProcessor.storeMorphSlot(corner); morphPad.repaint(); });
+    menu.addSubMenu("Load preset", presetMenu);
+    menu.addItem("Clear", audioProcessor.isMorphSlotFilled(corner), false, [this, corner] { audioProcessor.clearMorphSlot(corner); morphPad.repaint(); });
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&morphPad));
+}
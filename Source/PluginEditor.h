@@ -11,11 +11,14 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 #include "DualKnob.h"
+#include "XYPad.h"
+#include "BackgroundImageLoader.h"
+#include "GrainVisualiser.h"
 
 //==============================================================================
 /**
 */
-class ShatterAudioProcessorEditor  :  public juce::AudioProcessorEditor, public juce::Slider::Listener
+class ShatterAudioProcessorEditor  :  public juce::AudioProcessorEditor, public juce::Slider::Listener, private juce::ChangeListener
 {
 public:
     ShatterAudioProcessorEditor (ShatterAudioProcessor&);
@@ -26,15 +29,85 @@ public:
     void resized() override;
         
     void sliderValueChanged(juce::Slider* sliderChanged) override;
+    
+    static constexpr int defaultWidth = 1000;
+    static constexpr int defaultHeight = 560;
 
 private:
+    void showMorphCornerMenu(int corner);
+    void updateBackgroundCache();
+    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+    
     ShatterAudioProcessor& audioProcessor;
 
-    juce::Image background = juce::ImageCache::getFromMemory(BinaryData::particles_jpg, BinaryData::particles_jpgSize);
+    BackgroundImageLoader& backgroundLoader;
+    juce::Image background;
+    
+    // background already scaled to the editor's size in physical pixels, so paint is a plain copy
+    juce::Image scaledBackground;
+    float scaledBackgroundScale = 0.0f;
     
     DualKnob sizeKnobs;
     DualKnob densityKnobs;
     DualKnob widthAndSpreadKnobs;
+    DualKnob windowKnobs;
+    
+    GrainVisualiser grainVisualiser;
+    
+    XYPad morphPad;
+    juce::ToggleButton morphButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> morphButtonAttachment;
+    
+    juce::ComboBox placementBox;
+    juce::ToggleButton zeroSnapButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> zeroSnapAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> placementAttachment;
+    
+    juce::Slider reverseSlider;
+    juce::Label reverseLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> reverseAttachment;
+    
+    juce::Slider feedbackSlider;
+    juce::Label feedbackLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> feedbackAttachment;
+    
+    juce::Slider ageSlider;
+    juce::Label ageLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> ageAttachment;
+    
+    juce::ToggleButton microButton;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> microButtonAttachment;
+    
+    juce::Slider microSizeSlider;
+    juce::Label microSizeLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> microSizeAttachment;
+    
+    juce::Slider microRateSlider;
+    juce::Label microRateLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> microRateAttachment;
+    
+    juce::ComboBox filterBox;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> filterAttachment;
+    
+    juce::Slider cutoffSlider;
+    juce::Label cutoffLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> cutoffAttachment;
+    
+    juce::Slider resonanceSlider;
+    juce::Label resonanceLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> resonanceAttachment;
+    
+    juce::Slider filterSpreadSlider;
+    juce::Label filterSpreadLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> filterSpreadAttachment;
+    
+    juce::Slider mixSlider;
+    juce::Label mixLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> mixAttachment;
+    
+    juce::Slider gainSlider;
+    juce::Label gainLabel;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> gainAttachment;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ShatterAudioProcessorEditor)
 };
@@ -8,6 +8,8 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "BinaryState.h"
+#include "RealtimeGuard.h"
 
 //==============================================================================
 ShatterAudioProcessor::ShatterAudioProcessor()
@@ -22,10 +24,17 @@ ShatterAudioProcessor::ShatterAudioProcessor()
                        ), grainMill(std::make_unique<GrainProcessor>()), apvts(*this, nullptr, "Parameters", initParameters())
 #endif
 {
+    presets.createFactoryPresets(apvts);
+    currentParameters.capture(getParameters());
+    
+    // the pad controls themselves are never blended
+    for (auto* parameterID : { "MORPH", "MORPHX", "MORPHY" })
+        morphEngine.excludeParameter(apvts.getParameter(parameterID)->getParameterIndex());
 }
 
 ShatterAudioProcessor::~ShatterAudioProcessor()
 {
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -68,42 +77,131 @@ double ShatterAudioProcessor::getTailLengthSeconds() const
 
 int ShatterAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return presets.getNumPresets();   // always at least the factory "Init" program
 }
 
 int ShatterAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 
 void ShatterAudioProcessor::setCurrentProgram (int index)
 {
+    // the audio thread switches to the whole snapshot at once, the parameters then follow for the host and editor
+    auto& programChange = programChanges.getWriteBuffer();
+    
+    if (! presets.getSnapshot(index, programChange.snapshot))
+        return;
+    
+    currentProgram = index;
+    programChange.sequenceNumber = ++programChangeCount;
+    programChanges.publish();
+    
+    triggerAsyncUpdate();
+}
+
+void ShatterAudioProcessor::handleAsyncUpdate()
+{
+    // the count is read first, so if another change lands in between the newer program is set under
+    // the older number and the audio thread keeps holding it until the next update catches up
+    int sequenceNumber = programChangeCount;
+    ParameterSnapshot snapshot;
+    
+    if (presets.getSnapshot(currentProgram, snapshot))
+        setParametersFromSnapshot(snapshot);
+    
+    programChangesApplied = sequenceNumber;
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
 }
 
 const juce::String ShatterAudioProcessor::getProgramName (int index)
 {
-    return {};
+    return presets.getName(index);
 }
 
 void ShatterAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    presets.renamePreset(index, newName);
+}
+
+int ShatterAudioProcessor::saveUserPreset(const juce::String& name)
+{
+    ParameterSnapshot snapshot;
+    snapshot.capture(getParameters());
+    
+    int index = presets.addUserPreset(name, snapshot);
+    
+    // the bank is full
+    if (index < 0)
+        return -1;
+    
+    currentProgram = index;
+    updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+    
+    return index;
+}
+
+void ShatterAudioProcessor::setPresetMorphTime(float seconds)    { presetMorphTime = std::max(0.0f, seconds); }
+float ShatterAudioProcessor::getPresetMorphTime() const          { return presetMorphTime; }
+
+void ShatterAudioProcessor::storeMorphSlot(int slot)
+{
+    ParameterSnapshot snapshot;
+    snapshot.capture(getParameters());
+    morphEngine.setSlot(slot, snapshot);
+}
+
+void ShatterAudioProcessor::loadPresetIntoMorphSlot(int slot, int presetIndex)
+{
+    ParameterSnapshot snapshot;
+    
+    if (presets.getSnapshot(presetIndex, snapshot))
+        morphEngine.setSlot(slot, snapshot);
+}
+
+void ShatterAudioProcessor::clearMorphSlot(int slot)              { morphEngine.clearSlot(slot); }
+bool ShatterAudioProcessor::isMorphSlotFilled(int slot) const     { return morphEngine.isSlotFilled(slot); }
+
+void ShatterAudioProcessor::setDelayStorage(DelayStorage storage)
+{
+    if (storage == grainMill->getDelayStorage())
+        return;
+    
+    // the delay buffer is reallocated, which can't happen under a running block
+    suspendProcessing(true);
+    grainMill->setDelayStorage(storage);
+    suspendProcessing(false);
+}
+
+DelayStorage ShatterAudioProcessor::getDelayStorage() const       { return grainMill->getDelayStorage(); }
+
+void ShatterAudioProcessor::setLongHistory(double seconds)
+{
+    if (seconds == grainMill->getLongHistoryLength())
+        return;
+    
+    // the history file is created or deleted here, not under a running block
+    suspendProcessing(true);
+    grainMill->setLongHistoryLength(seconds);
+    suspendProcessing(false);
 }
 
+double ShatterAudioProcessor::getLongHistory() const              { return grainMill->getLongHistoryLength(); }
+BackgroundImageLoader& ShatterAudioProcessor::getBackgroundLoader()  { return *backgroundLoader; }
+
 //==============================================================================
 void ShatterAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
-    grainMill->setSampleRate(sampleRate);
-    
-    
+    grainMill->prepare(sampleRate, samplesPerBlock);
 }
 
 void ShatterAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    grainMill->release();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -135,22 +233,98 @@ bool ShatterAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 void ShatterAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    RealtimeGuard::ScopedAudioThread audioThread;
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
     
-    grainMill->setGrainSize(*apvts.getRawParameterValue("SIZE"));
-    grainMill->setGrainRandomSize(*apvts.getRawParameterValue("SIZERANDOM"));
-    grainMill->setGrainFrequency(*apvts.getRawParameterValue("DENSITY"));
-    grainMill->setGrainRandomFreq(*apvts.getRawParameterValue("DENSITYRANDOM"));
-    grainMill->setGrainWidth(*apvts.getRawParameterValue("WIDTH"));
-    grainMill->setGrainSpread(*apvts.getRawParameterValue("SPREAD"));
+    updateParameterSnapshot(buffer.getNumSamples());
+    applyMorph();
+    applyParameters(currentParameters);
    
     grainMill->grainify(buffer);
 }
 
+void ShatterAudioProcessor::updateParameterSnapshot(int numSamples)
+{
+    if (programChanges.update())
+    {
+        auto& programChange = programChanges.getReadBuffer();
+        
+        programMorphStart = currentParameters;
+        programMorphTarget = programChange.snapshot;
+        programMorphSequenceNumber = programChange.sequenceNumber;
+        programMorphLength = (int) (presetMorphTime * getSampleRate());
+        programMorphPosition = 0;
+        isFollowingProgram = true;
+    }
+    
+    if (! isFollowingProgram)
+    {
+        currentParameters.capture(getParameters());
+    }
+    else if (programMorphPosition < programMorphLength)
+    {
+        programMorphPosition = std::min(programMorphLength, programMorphPosition + numSamples);
+        currentParameters.interpolate(programMorphStart, programMorphTarget, (float) programMorphPosition / programMorphLength);
+    }
+    else
+    {
+        // hold the program until the parameters have caught up with it, then hand control back to them
+        currentParameters = programMorphTarget;
+        isFollowingProgram = programChangesApplied < programMorphSequenceNumber;
+    }
+}
+
+void ShatterAudioProcessor::applyMorph()
+{
+    // one blend per block stands in for automating every grain parameter
+    auto value = [this] (const char* parameterID) { return currentParameters.getValue(*apvts.getParameter(parameterID)); };
+    
+    if (value("MORPH") > 0.5f)
+        morphEngine.process(currentParameters, value("MORPHX"), value("MORPHY"));
+}
+
+void ShatterAudioProcessor::applyParameters(const ParameterSnapshot& snapshot)
+{
+    auto value = [this, &snapshot] (const char* parameterID) { return snapshot.getValue(*apvts.getParameter(parameterID)); };
+    
+    grainMill->setGrainSize(value("SIZE"));
+    grainMill->setGrainRandomSize(value("SIZERANDOM"));
+    grainMill->setGrainFrequency(value("DENSITY"));
+    grainMill->setGrainRandomFreq(value("DENSITYRANDOM"));
+    grainMill->setGrainWidth(value("WIDTH"));
+    grainMill->setGrainSpread(value("SPREAD"));
+    grainMill->setGrainPlacement((GrainPlacement)(int) value("PLACEMENT"));
+    grainMill->setZeroSnap(value("ZEROSNAP") > 0.5f);
+    grainMill->setReverseProbability(value("REVERSE"));
+    grainMill->setFeedback(value("FEEDBACK"));
+    grainMill->setGrainAge(value("AGE"));
+    grainMill->setMicroMode(value("MICRO") > 0.5f);
+    grainMill->setMicroGrainSize(value("MICROSIZE"));
+    grainMill->setMicroGrainRate(value("MICRORATE"));
+    grainMill->setFilterMode((GrainFilterMode)(int) value("FILTER"));
+    grainMill->setFilterCutoff(value("CUTOFF"));
+    grainMill->setFilterResonance(value("RESONANCE"));
+    grainMill->setFilterSpread(value("FILTERSPREAD"));
+    grainMill->setMix(value("MIX"));
+    grainMill->setOutputGain(juce::Decibels::decibelsToGain(value("GAIN")));
+    grainMill->setWindowShape((WindowShape)(int) value("SHAPE"));
+    grainMill->setWindowSkew(value("SKEW"));
+}
+
+void ShatterAudioProcessor::setParametersFromSnapshot(const ParameterSnapshot& snapshot)
+{
+    auto& allParameters = getParameters();
+    
+    for (int i = 0; i < snapshot.numValues; ++i)
+    {
+        allParameters.getUnchecked(i)->setValueNotifyingHost(snapshot.values[(size_t) i]);
+    }
+}
+
 //==============================================================================
 bool ShatterAudioProcessor::hasEditor() const
 {
@@ -165,14 +339,68 @@ juce::AudioProcessorEditor* ShatterAudioProcessor::createEditor()
 //==============================================================================
 void ShatterAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    auto state = apvts.copyState();
-    std::unique_ptr<juce::XmlElement> xml (state.createXml());
-    copyXmlToBinary (*xml, destData);
-
+    BinaryState::Writer writer(destData);
+    
+    ParameterSnapshot snapshot;
+    snapshot.capture(getParameters());
+    snapshot.write(writer.beginChunk("PARM"), getParameters());
+    writer.endChunk();
+    
+    auto& programStream = writer.beginChunk("PRST");
+    programStream.writeFloat(presetMorphTime);
+    presets.writeUserPresets(programStream, getParameters());
+    programStream.writeInt(currentProgram.load());
+    writer.endChunk();
+    
+    morphEngine.writeSlots(writer.beginChunk("MRPH"), getParameters());
+    writer.endChunk();
+    
+    auto& engineStream = writer.beginChunk("ENGN");
+    engineStream.writeFloat(grainMill->getGovernor().getMaximumLoad());
+    engineStream.writeInt((int) grainMill->getDelayStorage());
+    engineStream.writeFloat((float) grainMill->getLongHistoryLength());
+    writer.endChunk();
 }
 
 void ShatterAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
+    if (BinaryState::hasBinaryHeader(data, sizeInBytes))
+    {
+        BinaryState::Reader reader(data, sizeInBytes);
+        
+        while (reader.nextChunk())
+        {
+            auto& stream = reader.getChunkStream();
+            
+            if (reader.isChunk("PARM"))
+            {
+                ParameterSnapshot snapshot;
+                snapshot.read(stream, apvts);
+                setParametersFromSnapshot(snapshot);
+            }
+            else if (reader.isChunk("PRST"))
+            {
+                setPresetMorphTime(stream.readFloat());
+                presets.readUserPresets(stream, apvts);
+                currentProgram = juce::jlimit(0, presets.getNumPresets() - 1, stream.readInt());
+                updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+            }
+            else if (reader.isChunk("MRPH"))
+            {
+                morphEngine.readSlots(stream, apvts);
+            }
+            else if (reader.isChunk("ENGN"))
+            {
+                grainMill->getGovernor().setMaximumLoad(stream.readFloat());
+                setDelayStorage((DelayStorage) juce::jlimit(0, 1, stream.readInt()));
+                setLongHistory(juce::jlimit(0.0, 3600.0, (double) stream.readFloat()));
+            }
+        }
+        
+        return;
+    }
+    
+    // sessions saved before the binary format store the value tree as xml
     std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
     
     if (xmlState.get() != nullptr)
@@ -195,6 +423,18 @@ juce::AudioProcessorValueTreeState::ParameterLayout ShatterAudioProcessor::initP
     float initRandom = 0.0f;
     float initWidth = 0.0f;
     float initSpread = 0.0f;
+    float initReverse = 0.0f;
+    float initFeedback = 0.0f;
+    float initAge = 0.0f;
+    float initMicroSize = 10.0f;
+    float initMicroRate = 500.0f;
+    float initCutoff = 2000.0f;
+    float initResonance = 0.707f;
+    float initFilterSpread = 0.0f;
+    float initMix = 1.0f;
+    float initGain = 0.0f;
+    float initSkew = 0.5f;
+    float initMorph = 0.5f;
     
     parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"SIZE", 1}, "Size", 0.05f, 2.0f, initSize));
     parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"SIZERANDOM", 1}, "Size Random", 0.0f, 1.0f, initRandom));
@@ -206,6 +446,38 @@ juce::AudioProcessorValueTreeState::ParameterLayout ShatterAudioProcessor::initP
     juce::NormalisableRange<float> spreadRange = juce::NormalisableRange<float>(0.0f, 1000.0f, 1.0f);
     spreadRange.setSkewForCentre(200.0);
     parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"SPREAD", 1}, "Spread", spreadRange, initSpread));
+    parameters.push_back(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{"PLACEMENT", 1}, "Placement", AmplitudeIndex::getPlacementNames(), (int) GrainPlacement::uniform));
+    parameters.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{"ZEROSNAP", 1}, "Zero Snap", false));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"REVERSE", 1}, "Reverse", 0.0f, 1.0f, initReverse));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"FEEDBACK", 1}, "Feedback", 0.0f, 0.95f, initFeedback));
+    juce::NormalisableRange<float> ageRange = juce::NormalisableRange<float>(0.0f, 3600.0f);
+    ageRange.setSkewForCentre(10.0f);
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"AGE", 1}, "Age", ageRange, initAge));
+    
+    parameters.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{"MICRO", 1}, "Micro", false));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"MICROSIZE", 1}, "Micro Size", 1.0f, 50.0f, initMicroSize));
+    juce::NormalisableRange<float> microRateRange = juce::NormalisableRange<float>(10.0f, 5000.0f);
+    microRateRange.setSkewForCentre(300.0f);
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"MICRORATE", 1}, "Micro Rate", microRateRange, initMicroRate));
+    
+    parameters.push_back(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{"FILTER", 1}, "Filter", GrainFilterBank::getModeNames(), (int) GrainFilterMode::off));
+    juce::NormalisableRange<float> cutoffRange = juce::NormalisableRange<float>(20.0f, 20000.0f);
+    cutoffRange.setSkewForCentre(1000.0f);
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"CUTOFF", 1}, "Cutoff", cutoffRange, initCutoff));
+    juce::NormalisableRange<float> resonanceRange = juce::NormalisableRange<float>(0.5f, 20.0f);
+    resonanceRange.setSkewForCentre(2.0f);
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"RESONANCE", 1}, "Resonance", resonanceRange, initResonance));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"FILTERSPREAD", 1}, "Filter Spread", 0.0f, 4.0f, initFilterSpread));
+    
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"MIX", 1}, "Mix", 0.0f, 1.0f, initMix));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"GAIN", 1}, "Output Gain", -24.0f, 12.0f, initGain));
+    
+    parameters.push_back(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID{"SHAPE", 1}, "Window Shape", GrainWindow::getShapeNames(), (int) WindowShape::hann));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"SKEW", 1}, "Window Skew", 0.05f, 0.95f, initSkew));
+    
+    parameters.push_back(std::make_unique<juce::AudioParameterBool>(juce::ParameterID{"MORPH", 1}, "Morph", false));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"MORPHX", 1}, "Morph X", 0.0f, 1.0f, initMorph));
+    parameters.push_back(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID{"MORPHY", 1}, "Morph Y", 0.0f, 1.0f, initMorph));
        
     return {parameters.begin(), parameters.end()};
 }
@@ -10,11 +10,16 @@
 
 #include <JuceHeader.h>
 #include "GrainProcessor.h"
+#include "PresetBank.h"
+#include "MorphEngine.h"
+#include "TripleBuffer.h"
+#include "BackgroundImageLoader.h"
 
 //==============================================================================
 /**
 */
-class ShatterAudioProcessor  : public juce::AudioProcessor
+class ShatterAudioProcessor  : public juce::AudioProcessor,
+                               private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -56,11 +61,63 @@ public:
     
     juce::AudioProcessorValueTreeState::ParameterLayout initParameters();
     
-    std::vector<std::unique_ptr<juce::AudioParameterFloat>> parameters;
+    int saveUserPreset(const juce::String& name);
+    void setPresetMorphTime(float seconds);
+    float getPresetMorphTime() const;
+    
+    void storeMorphSlot(int slot);
+    void loadPresetIntoMorphSlot(int slot, int presetIndex);
+    void clearMorphSlot(int slot);
+    bool isMorphSlotFilled(int slot) const;
+    
+    void setDelayStorage(DelayStorage storage);
+    DelayStorage getDelayStorage() const;
+    void setLongHistory(double seconds);
+    double getLongHistory() const;
+    
+    BackgroundImageLoader& getBackgroundLoader();
+    
+    std::vector<std::unique_ptr<juce::RangedAudioParameter>> parameters;
     std::unique_ptr<GrainProcessor> grainMill;
     juce::AudioProcessorValueTreeState apvts;
 
 private:
+    void updateParameterSnapshot(int numSamples);
+    void applyMorph();
+    void applyParameters(const ParameterSnapshot& snapshot);
+    void setParametersFromSnapshot(const ParameterSnapshot& snapshot);
+    void handleAsyncUpdate() override;
+    
+    PresetBank presets;
+    std::atomic<int> currentProgram { 0 };
+    std::atomic<float> presetMorphTime { 0.0f };   // seconds taken to morph into a newly selected program
+    
+    // program changes are handed to the audio thread as whole snapshots, the parameters are then
+    // moved to match from the message thread, since some hosts change programs on the audio thread
+    struct ProgramChange
+    {
+        ParameterSnapshot snapshot;
+        int sequenceNumber = 0;
+    };
+    
+    TripleBuffer<ProgramChange> programChanges;
+    std::atomic<int> programChangeCount { 0 };
+    std::atomic<int> programChangesApplied { 0 };
+    
+    MorphEngine morphEngine;
+    
+    // shared by every instance, so the decoded background outlives the editors
+    juce::SharedResourcePointer<BackgroundImageLoader> backgroundLoader;
+    
+    // audio thread only
+    ParameterSnapshot currentParameters;
+    ParameterSnapshot programMorphStart;
+    ParameterSnapshot programMorphTarget;
+    int programMorphSequenceNumber = 0;
+    int programMorphLength = 0;
+    int programMorphPosition = 0;
+    bool isFollowingProgram = false;
+    
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ShatterAudioProcessor)
     
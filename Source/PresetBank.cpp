@@ -0,0 +1,222 @@
+#include "PresetBank.h"
+
+namespace
+{
+    struct FactoryPreset
+    {
+        const char* name;
+        std::vector<std::pair<const char*, float>> values;     // unnormalised, anything missing keeps its default
+    };
+
+    const std::vector<FactoryPreset> factoryPresetList =
+    {
+        { "Init",           {} },
+        { "Soft Cloud",     { { "SIZE", 0.8f }, { "SIZERANDOM", 0.3f }, { "DENSITY", 12.0f }, { "DENSITYRANDOM", 0.2f }, { "WIDTH", 0.6f }, { "SPREAD", 300.0f } } },
+        { "Glass Shards",   { { "SIZE", 0.1f }, { "SIZERANDOM", 0.5f }, { "DENSITY", 25.0f }, { "DENSITYRANDOM", 0.8f }, { "WIDTH", 1.0f }, { "SPREAD", 600.0f }, { "SHAPE", 3.0f }, { "SKEW", 0.1f }, { "PLACEMENT", 3.0f } } },
+        { "Slow Swell",     { { "SIZE", 1.8f }, { "DENSITY", 3.0f }, { "WIDTH", 0.4f }, { "SPREAD", 900.0f }, { "SHAPE", 2.0f }, { "SKEW", 0.85f }, { "REVERSE", 0.5f } } },
+        { "Stutter",        { { "SIZE", 0.15f }, { "DENSITY", 8.0f }, { "SHAPE", 1.0f }, { "SKEW", 0.2f } } },
+        { "Wide Scatter",   { { "SIZE", 0.3f }, { "SIZERANDOM", 1.0f }, { "DENSITY", 18.0f }, { "DENSITYRANDOM", 1.0f }, { "WIDTH", 1.0f }, { "SPREAD", 1000.0f } } }
+    };
+}
+
+void ParameterSnapshot::capture(const juce::Array<juce::AudioProcessorParameter*>& parameters)
+{
+    jassert(parameters.size() <= maxParameters);
+    numValues = std::min(parameters.size(), maxParameters);
+
+    for (int i = 0; i < numValues; ++i)
+    {
+        values[(size_t) i] = parameters.getUnchecked(i)->getValue();
+    }
+}
+
+void ParameterSnapshot::interpolate(const ParameterSnapshot& start, const ParameterSnapshot& end, float amount)
+{
+    numValues = end.numValues;
+
+    for (int i = 0; i < numValues; ++i)
+    {
+        values[(size_t) i] = start.values[(size_t) i] + amount * (end.values[(size_t) i] - start.values[(size_t) i]);
+    }
+}
+
+float ParameterSnapshot::getValue(const juce::RangedAudioParameter& parameter) const
+{
+    return parameter.convertFrom0to1(values[(size_t) parameter.getParameterIndex()]);
+}
+
+void ParameterSnapshot::write(juce::OutputStream& stream, const juce::Array<juce::AudioProcessorParameter*>& parameters) const
+{
+    stream.writeInt(numValues);
+
+    for (int i = 0; i < numValues; ++i)
+    {
+        auto* parameter = static_cast<juce::RangedAudioParameter*>(parameters.getUnchecked(i));
+
+        stream.writeString(parameter->getParameterID());
+        stream.writeFloat(parameter->convertFrom0to1(values[(size_t) i]));
+    }
+}
+
+void ParameterSnapshot::read(juce::InputStream& stream, juce::AudioProcessorValueTreeState& valueTreeState)
+{
+    auto& parameters = valueTreeState.processor.getParameters();
+    numValues = std::min(parameters.size(), maxParameters);
+
+    for (int i = 0; i < numValues; ++i)
+    {
+        values[(size_t) i] = parameters.getUnchecked(i)->getDefaultValue();
+    }
+
+    int numStoredParameters = stream.readInt();
+
+    for (int i = 0; i < numStoredParameters && ! stream.isExhausted(); ++i)
+    {
+        auto parameterID = stream.readString();
+        float value = stream.readFloat();
+
+        if (auto* parameter = valueTreeState.getParameter(parameterID))
+        {
+            values[(size_t) parameter->getParameterIndex()] = parameter->convertTo0to1(value);
+        }
+    }
+}
+
+void PresetBank::createFactoryPresets(juce::AudioProcessorValueTreeState& valueTreeState)
+{
+    auto& parameters = valueTreeState.processor.getParameters();
+    numPresets = 0;
+    names.clear();
+
+    for (auto& factoryPreset : factoryPresetList)
+    {
+        ParameterSnapshot snapshot;
+        snapshot.numValues = std::min(parameters.size(), ParameterSnapshot::maxParameters);
+
+        for (int i = 0; i < snapshot.numValues; ++i)
+        {
+            snapshot.values[(size_t) i] = parameters.getUnchecked(i)->getDefaultValue();
+        }
+
+        for (auto& [parameterID, value] : factoryPreset.values)
+        {
+            if (auto* parameter = valueTreeState.getParameter(parameterID))
+            {
+                snapshot.values[(size_t) parameter->getParameterIndex()] = parameter->convertTo0to1(value);
+            }
+        }
+
+        setSnapshot(names.size(), snapshot);
+        names.add(factoryPreset.name);
+    }
+
+    numFactoryPresets = names.size();
+    numPresets = numFactoryPresets;
+}
+
+int PresetBank::getNumPresets() const
+{
+    return numPresets.load(std::memory_order_acquire);
+}
+
+bool PresetBank::getSnapshot(int index, ParameterSnapshot& snapshot) const
+{
+    for (;;)
+    {
+        if (! juce::isPositiveAndBelow(index, getNumPresets()))
+        {
+            return false;
+        }
+
+        // copied again if the writer got to it meanwhile
+        auto before = sequence.load(std::memory_order_acquire);
+
+        if ((before & 1) != 0)
+        {
+            continue;
+        }
+
+        snapshot = snapshots[(size_t) index];
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (sequence.load(std::memory_order_relaxed) == before)
+        {
+            return true;
+        }
+    }
+}
+
+void PresetBank::setSnapshot(int index, const ParameterSnapshot& snapshot)
+{
+    sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    snapshots[(size_t) index] = snapshot;
+
+    sequence.fetch_add(1, std::memory_order_release);
+}
+
+juce::String PresetBank::getName(int index) const
+{
+    return names[index];
+}
+
+bool PresetBank::isFactoryPreset(int index) const
+{
+    return index < numFactoryPresets;
+}
+
+int PresetBank::addUserPreset(const juce::String& name, const ParameterSnapshot& snapshot)
+{
+    int index = names.size();
+
+    if (index >= maxPresets)
+    {
+        return -1;
+    }
+
+    // written before it's counted, so no reader looks at it half done
+    setSnapshot(index, snapshot);
+    names.add(name);
+    numPresets.store(index + 1, std::memory_order_release);
+
+    return index;
+}
+
+void PresetBank::renamePreset(int index, const juce::String& newName)
+{
+    // factory presets keep their names
+    if (juce::isPositiveAndBelow(index, names.size()) && ! isFactoryPreset(index))
+    {
+        names.set(index, newName);
+    }
+}
+
+void PresetBank::writeUserPresets(juce::OutputStream& stream, const juce::Array<juce::AudioProcessorParameter*>& parameters) const
+{
+    stream.writeInt(names.size() - numFactoryPresets);
+
+    for (int index = numFactoryPresets; index < names.size(); ++index)
+    {
+        stream.writeString(names[index]);
+        snapshots[(size_t) index].write(stream, parameters);
+    }
+}
+
+void PresetBank::readUserPresets(juce::InputStream& stream, juce::AudioProcessorValueTreeState& valueTreeState)
+{
+    // the old user presets stop being readable before they're overwritten
+    numPresets.store(numFactoryPresets, std::memory_order_release);
+    names.removeRange(numFactoryPresets, names.size() - numFactoryPresets);
+
+    int numStoredPresets = stream.readInt();
+
+    for (int i = 0; i < numStoredPresets && ! stream.isExhausted(); ++i)
+    {
+        auto name = stream.readString();
+        ParameterSnapshot snapshot;
+        snapshot.read(stream, valueTreeState);
+
+        addUserPreset(name, snapshot);
+    }
+}
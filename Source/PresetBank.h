@@ -0,0 +1,56 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Normalised values of every plugin parameter, in parameter index order.
+// Fixed size so that it can be copied around on the audio thread.
+struct ParameterSnapshot
+{
+    static constexpr int maxParameters = 32;
+
+    void capture(const juce::Array<juce::AudioProcessorParameter*>& parameters);
+    void interpolate(const ParameterSnapshot& start, const ParameterSnapshot& end, float amount);
+    float getValue(const juce::RangedAudioParameter& parameter) const;
+
+    // stored as ID and unnormalised value pairs, parameters missing from the stream get their defaults
+    void write(juce::OutputStream& stream, const juce::Array<juce::AudioProcessorParameter*>& parameters) const;
+    void read(juce::InputStream& stream, juce::AudioProcessorValueTreeState& valueTreeState);
+
+    std::array<float, maxParameters> values {};
+    int numValues = 0;
+};
+
+// Factory presets followed by the user's. Snapshots live in a fixed array
+// behind a sequence lock, so a host changing programs on the audio thread
+// can read them while the message thread adds or reloads user presets.
+// Names are only for the message thread.
+class PresetBank
+{
+public:
+    static constexpr int maxPresets = 128;
+
+    void createFactoryPresets(juce::AudioProcessorValueTreeState& valueTreeState);
+
+    // any thread
+    int getNumPresets() const;
+    bool getSnapshot(int index, ParameterSnapshot& snapshot) const;     // false when there's no such preset
+
+    juce::String getName(int index) const;
+    bool isFactoryPreset(int index) const;
+
+    // the new preset's index, -1 when the bank is full
+    int addUserPreset(const juce::String& name, const ParameterSnapshot& snapshot);
+    void renamePreset(int index, const juce::String& newName);
+
+    void writeUserPresets(juce::OutputStream& stream, const juce::Array<juce::AudioProcessorParameter*>& parameters) const;
+    void readUserPresets(juce::InputStream& stream, juce::AudioProcessorValueTreeState& valueTreeState);
+
+private:
+    // message thread, the only writer
+    void setSnapshot(int index, const ParameterSnapshot& snapshot);
+
+    std::array<ParameterSnapshot, maxPresets> snapshots;
+    juce::StringArray names;
+    int numFactoryPresets = 0;
+    std::atomic<int> numPresets { 0 };
+    std::atomic<juce::uint32> sequence { 0 };    // odd while a snapshot is being written
+};
@@ -0,0 +1,260 @@
+#include "RealtimeGuard.h"
+
+#if SHATTER_RT_GUARD
+
+#include <new>
+#include <cerrno>
+#include <cstdlib>
+#include <utility>
+#include <pthread.h>
+
+#if defined(__GLIBC__)
+ #include <dlfcn.h>
+
+ // the allocator underneath malloc, which stays reachable when malloc itself is replaced
+ extern "C"
+ {
+     void* __libc_malloc(size_t size);
+     void* __libc_calloc(size_t count, size_t size);
+     void* __libc_realloc(void* pointer, size_t size);
+     void* __libc_memalign(size_t alignment, size_t size);
+     void __libc_free(void* pointer);
+ }
+#endif
+
+namespace
+{
+   #if defined(__GNUC__)
+    // a dynamic TLS lookup can allocate, which would come straight back into malloc
+    __attribute__((tls_model("initial-exec"))) thread_local int audioThreadDepth = 0;
+   #else
+    thread_local int audioThreadDepth = 0;
+   #endif
+
+    std::atomic<int> numViolations { 0 };
+
+    void checkAudioThread(const char* operation)
+    {
+        if (audioThreadDepth == 0)
+        {
+            return;
+        }
+
+        // the report allocates and locks too
+        int depth = std::exchange(audioThreadDepth, 0);
+        ++numViolations;
+        juce::Logger::outputDebugString(juce::String("RealtimeGuard: ") + operation + " on the audio thread" + juce::newLine + juce::SystemStats::getStackBacktrace());
+        jassertfalse;
+        audioThreadDepth = depth;
+    }
+
+    // operator new checks for itself, so it allocates without going through the replaced malloc,
+    // on macOS calls from this file are never interposed, so malloc already is the original
+    void* rawAllocate(std::size_t size)
+    {
+       #if defined(__GLIBC__)
+        return __libc_malloc(size);
+       #else
+        return std::malloc(size);
+       #endif
+    }
+
+    void rawFree(void* pointer)
+    {
+       #if defined(__GLIBC__)
+        __libc_free(pointer);
+       #else
+        std::free(pointer);
+       #endif
+    }
+
+    void* allocate(std::size_t size)
+    {
+        checkAudioThread("operator new");
+        return rawAllocate(size == 0 ? 1 : size);
+    }
+
+    void deallocate(void* pointer)
+    {
+        if (pointer != nullptr)
+        {
+            checkAudioThread("operator delete");
+        }
+
+        rawFree(pointer);
+    }
+
+    bool isValidAlignment(size_t alignment)
+    {
+        return alignment >= sizeof(void*) && (alignment & (alignment - 1)) == 0;
+    }
+}
+
+RealtimeGuard::ScopedAudioThread::ScopedAudioThread()       { ++audioThreadDepth; }
+RealtimeGuard::ScopedAudioThread::~ScopedAudioThread()      { --audioThreadDepth; }
+int RealtimeGuard::getNumViolations()                       { return numViolations; }
+
+void* operator new(std::size_t size)
+{
+    if (auto* pointer = allocate(size))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (auto* pointer = allocate(size))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept        { return allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept      { return allocate(size); }
+void operator delete(void* pointer) noexcept                                { deallocate(pointer); }
+void operator delete[](void* pointer) noexcept                              { deallocate(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept                   { deallocate(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept                 { deallocate(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept         { deallocate(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept       { deallocate(pointer); }
+
+#if defined(__GLIBC__)
+
+namespace
+{
+    using MutexLock = int (*)(pthread_mutex_t*);
+    std::atomic<MutexLock> realMutexLock { nullptr };
+
+    // looked up on first use, a function local static would take a lock of its own to initialise
+    MutexLock getRealMutexLock()
+    {
+        auto function = realMutexLock.load(std::memory_order_relaxed);
+
+        if (function == nullptr)
+        {
+            function = reinterpret_cast<MutexLock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+            realMutexLock.store(function, std::memory_order_relaxed);
+        }
+
+        return function;
+    }
+}
+
+#define SHATTER_GUARD_EXPORT __attribute__((visibility("default")))
+
+extern "C"
+{
+    SHATTER_GUARD_EXPORT void* malloc(size_t size) noexcept
+    {
+        checkAudioThread("malloc");
+        return __libc_malloc(size);
+    }
+
+    SHATTER_GUARD_EXPORT void* calloc(size_t count, size_t size) noexcept
+    {
+        checkAudioThread("calloc");
+        return __libc_calloc(count, size);
+    }
+
+    SHATTER_GUARD_EXPORT void* realloc(void* pointer, size_t size) noexcept
+    {
+        checkAudioThread("realloc");
+        return __libc_realloc(pointer, size);
+    }
+
+    SHATTER_GUARD_EXPORT int posix_memalign(void** result, size_t alignment, size_t size) noexcept
+    {
+        checkAudioThread("posix_memalign");
+
+        if (! isValidAlignment(alignment))
+        {
+            return EINVAL;
+        }
+
+        *result = __libc_memalign(alignment, size);
+        return *result != nullptr ? 0 : ENOMEM;
+    }
+
+    SHATTER_GUARD_EXPORT void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        checkAudioThread("aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    SHATTER_GUARD_EXPORT void free(void* pointer) noexcept
+    {
+        if (pointer != nullptr)
+        {
+            checkAudioThread("free");
+        }
+
+        __libc_free(pointer);
+    }
+
+    SHATTER_GUARD_EXPORT int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+    {
+        checkAudioThread("pthread_mutex_lock");
+        return getRealMutexLock()(mutex);
+    }
+}
+
+#elif JUCE_MAC
+
+#include <malloc/malloc.h>
+
+namespace
+{
+    // dyld swaps these in for the originals everywhere except in this file
+    void* guardedMalloc(size_t size)                        { checkAudioThread("malloc"); return malloc(size); }
+    void* guardedCalloc(size_t count, size_t size)          { checkAudioThread("calloc"); return calloc(count, size); }
+    void* guardedRealloc(void* pointer, size_t size)        { checkAudioThread("realloc"); return realloc(pointer, size); }
+    void* guardedAlignedAlloc(size_t alignment, size_t size) { checkAudioThread("aligned_alloc"); return aligned_alloc(alignment, size); }
+
+    int guardedPosixMemalign(void** result, size_t alignment, size_t size)
+    {
+        checkAudioThread("posix_memalign");
+        return posix_memalign(result, alignment, size);
+    }
+
+    void guardedFree(void* pointer)
+    {
+        if (pointer != nullptr)
+        {
+            checkAudioThread("free");
+        }
+
+        free(pointer);
+    }
+
+    int guardedMutexLock(pthread_mutex_t* mutex)
+    {
+        checkAudioThread("pthread_mutex_lock");
+        return pthread_mutex_lock(mutex);
+    }
+
+    struct Interpose
+    {
+        const void* replacement;
+        const void* original;
+    };
+
+    __attribute__((used, section("__DATA,__interpose"))) const Interpose interposes[] =
+    {
+        { (const void*) &guardedMalloc,          (const void*) &malloc },
+        { (const void*) &guardedCalloc,          (const void*) &calloc },
+        { (const void*) &guardedRealloc,         (const void*) &realloc },
+        { (const void*) &guardedAlignedAlloc,    (const void*) &aligned_alloc },
+        { (const void*) &guardedPosixMemalign,   (const void*) &posix_memalign },
+        { (const void*) &guardedFree,            (const void*) &free },
+        { (const void*) &guardedMutexLock,       (const void*) &pthread_mutex_lock }
+    };
+}
+
+#endif
+
+#endif
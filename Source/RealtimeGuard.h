@@ -0,0 +1,36 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Debug check that the audio callback never touches the heap or blocks on a
+// lock. Compiled out unless the project defines SHATTER_RT_GUARD=1. Any call
+// made on a thread inside a ScopedAudioThread is then counted, printed with a
+// stack trace and stops in the debugger.
+//
+// operator new and delete are always replaced. With glibc and on macOS,
+// malloc, calloc, realloc, the aligned allocators, free and pthread_mutex_lock
+// are replaced too. That covers every library when the guard is linked into an
+// executable, such as the RealtimeValidator harness. Inside a plugin binary
+// only the plugin's own calls are seen. pthread_mutex_trylock isn't trapped,
+// since trying a lock never blocks.
+#ifndef SHATTER_RT_GUARD
+ #define SHATTER_RT_GUARD 0
+#endif
+
+namespace RealtimeGuard
+{
+    // marks the current thread as running the audio callback while it exists
+    struct ScopedAudioThread
+    {
+       #if SHATTER_RT_GUARD
+        ScopedAudioThread();
+        ~ScopedAudioThread();
+       #else
+        ScopedAudioThread() {}     // user provided, so an unused guard doesn't warn
+       #endif
+    };
+
+   #if SHATTER_RT_GUARD
+    // allocations and locks seen on a marked thread so far, for a harness to fail on
+    int getNumViolations();
+   #endif
+}
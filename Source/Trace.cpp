@@ -0,0 +1,184 @@
+#include "Trace.h"
+
+#if SHATTER_ENABLE_TRACING
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <pthread.h>
+#endif
+
+namespace
+{
+    struct Event
+    {
+        const char* name;
+        juce::int64 ticks;
+        juce::int64 id;
+        Trace::Phase phase;
+    };
+
+    struct Ring
+    {
+        static constexpr juce::uint64 capacity = 1 << 15;
+
+        std::vector<Event> events = std::vector<Event>(capacity);
+        std::atomic<juce::uint64> numWritten { 0 };
+        std::atomic<bool> isOwned { false };
+        char threadName[64] = {};
+    };
+
+    constexpr int maxThreads = 8;
+
+   #if JUCE_WINDOWS
+    void WINAPI releaseRing(void* ring)
+   #else
+    void releaseRing(void* ring)
+   #endif
+    {
+        static_cast<Ring*>(ring)->isOwned.store(false, std::memory_order_release);
+    }
+
+    // a thread's ring goes back to the pool when the thread exits, through a thread specific value
+    // with a destructor, which unlike a thread_local object doesn't allocate when it's first set
+    struct RingPool
+    {
+       #if JUCE_WINDOWS
+        RingPool()      { threadExitKey = FlsAlloc(releaseRing); }
+        ~RingPool()     { FlsFree(threadExitKey); }
+
+        void releaseOnThreadExit(Ring& ring)    { FlsSetValue(threadExitKey, &ring); }
+
+        DWORD threadExitKey;
+       #else
+        RingPool()      { pthread_key_create(&threadExitKey, releaseRing); }
+        ~RingPool()     { pthread_key_delete(threadExitKey); }
+
+        void releaseOnThreadExit(Ring& ring)    { pthread_setspecific(threadExitKey, &ring); }
+
+        pthread_key_t threadExitKey;
+       #endif
+
+        std::array<Ring, maxThreads> rings;
+    };
+
+    // built when the plugin is loaded, long before any thread records
+    RingPool pool;
+
+   #if defined(__GNUC__)
+    // the first access from a thread in a dynamically loaded plugin would otherwise allocate
+    __attribute__((tls_model("initial-exec"))) thread_local Ring* threadRing = nullptr;
+    __attribute__((tls_model("initial-exec"))) thread_local bool hasClaimedRing = false;
+   #else
+    thread_local Ring* threadRing = nullptr;
+    thread_local bool hasClaimedRing = false;
+   #endif
+
+    Ring* claimRing()
+    {
+        hasClaimedRing = true;
+
+        // unused rings first, a ring left by a thread that has exited loses that thread's events when it's reused
+        for (bool shouldReuse : { false, true })
+        {
+            for (auto& ring : pool.rings)
+            {
+                bool wasOwned = false;
+
+                if ((! shouldReuse && ring.numWritten.load() > 0) || ! ring.isOwned.compare_exchange_strong(wasOwned, true, std::memory_order_acquire))
+                {
+                    continue;
+                }
+
+                ring.numWritten.store(0, std::memory_order_release);
+                ring.threadName[0] = 0;
+
+                if (auto* thread = juce::Thread::getCurrentThread())
+                {
+                    thread->getThreadName().copyToUTF8(ring.threadName, sizeof(ring.threadName));
+                }
+
+                pool.releaseOnThreadExit(ring);
+                return &ring;
+            }
+        }
+
+        // threads past the pool go unrecorded
+        return nullptr;
+    }
+
+    juce::String toJson(const Event& event, int threadID)
+    {
+        juce::String json;
+        json << "{\"name\":\"" << event.name << "\",\"cat\":\"shatter\",\"ph\":\"" << juce::String::charToString((juce::juce_wchar) event.phase)
+             << "\",\"ts\":" << juce::String(juce::Time::highResolutionTicksToSeconds(event.ticks) * 1.0e6, 3)
+             << ",\"pid\":1,\"tid\":" << threadID;
+
+        if (event.phase == Trace::Phase::asyncBegin || event.phase == Trace::Phase::asyncEnd)
+        {
+            json << ",\"id\":" << event.id;
+        }
+
+        return json << "}";
+    }
+}
+
+void Trace::record(const char* name, Phase phase, juce::int64 id)
+{
+    if (! hasClaimedRing)
+    {
+        threadRing = claimRing();
+    }
+
+    if (threadRing == nullptr)
+    {
+        return;
+    }
+
+    auto index = threadRing->numWritten.load(std::memory_order_relaxed);
+    threadRing->events[(size_t) (index % Ring::capacity)] = { name, juce::Time::getHighResolutionTicks(), id, phase };
+    threadRing->numWritten.store(index + 1, std::memory_order_release);
+}
+
+bool Trace::writeChromeTrace(const juce::File& file)
+{
+    file.deleteFile();
+    juce::FileOutputStream stream(file);
+
+    if (! stream.openedOk())
+    {
+        return false;
+    }
+
+    stream << "{\"traceEvents\":[";
+    juce::String separator = "\n";
+
+    for (int thread = 0; thread < maxThreads; ++thread)
+    {
+        auto& ring = pool.rings[(size_t) thread];
+        auto numWritten = ring.numWritten.load(std::memory_order_acquire);
+
+        if (numWritten == 0)
+        {
+            continue;
+        }
+        juce::String threadName = ring.threadName[0] != 0 ? juce::String(ring.threadName) : "Thread " + juce::String(thread + 1);
+
+        stream << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread + 1
+               << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+        separator = ",\n";
+
+        for (auto i = numWritten > Ring::capacity ? numWritten - Ring::capacity : 0; i < numWritten; ++i)
+        {
+            stream << separator << toJson(ring.events[(size_t) (i % Ring::capacity)], thread + 1);
+        }
+    }
+
+    stream << "\n]}\n";
+    return true;
+}
+
+#endif
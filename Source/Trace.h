@@ -0,0 +1,49 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Timeline markers for chrome://tracing or Perfetto, compiled out unless the
+// project defines SHATTER_ENABLE_TRACING=1. Every thread that records claims
+// one of a fixed set of rings allocated when the plugin is loaded, so
+// recording never allocates or locks, and hands it back when it exits. A ring
+// keeps its most recent events, overwriting the oldest.
+#ifndef SHATTER_ENABLE_TRACING
+ #define SHATTER_ENABLE_TRACING 0
+#endif
+
+namespace Trace
+{
+    // Chrome trace phases, async events pair up by id rather than by thread
+    enum class Phase : char
+    {
+        begin = 'B',
+        end = 'E',
+        asyncBegin = 'b',
+        asyncEnd = 'e'
+    };
+
+   #if SHATTER_ENABLE_TRACING
+    // names are kept as pointers, so they have to be string literals
+    void record(const char* name, Phase phase, juce::int64 id = 0);
+
+    // every ring as Chrome trace JSON, events being recorded meanwhile may come out torn
+    bool writeChromeTrace(const juce::File& file);
+
+    struct ScopedEvent
+    {
+        explicit ScopedEvent(const char* eventName) : name(eventName)   { record(name, Phase::begin); }
+        ~ScopedEvent()                                                  { record(name, Phase::end); }
+
+        const char* name;
+    };
+   #endif
+}
+
+#if SHATTER_ENABLE_TRACING
+ #define SHATTER_TRACE_SCOPE(name)              Trace::ScopedEvent JUCE_JOIN_MACRO(traceEvent, __LINE__) (name)
+ #define SHATTER_TRACE_ASYNC_BEGIN(name, id)    Trace::record(name, Trace::Phase::asyncBegin, id)
+ #define SHATTER_TRACE_ASYNC_END(name, id)      Trace::record(name, Trace::Phase::asyncEnd, id)
+#else
+ #define SHATTER_TRACE_SCOPE(name)
+ #define SHATTER_TRACE_ASYNC_BEGIN(name, id)
+ #define SHATTER_TRACE_ASYNC_END(name, id)
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Hands the most recent value from one writer thread to one reader thread
+// without locking. The writer fills getWriteBuffer() and publishes it, the
+// reader swaps in whatever was published last and never sees a half-written value.
+template <typename ValueType>
+class TripleBuffer
+{
+public:
+    ValueType& getWriteBuffer()                 { return buffers[(size_t) writeIndex]; }
+
+    void publish()
+    {
+        writeIndex = middle.exchange(writeIndex | newValueFlag) & indexMask;
+    }
+
+    // returns true if a newer value was published since the last call
+    bool update()
+    {
+        if ((middle.load() & newValueFlag) == 0)
+        {
+            return false;
+        }
+
+        readIndex = middle.exchange(readIndex) & indexMask;
+        return true;
+    }
+
+    const ValueType& getReadBuffer() const      { return buffers[(size_t) readIndex]; }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int newValueFlag = 4;
+
+    std::array<ValueType, 3> buffers;
+    int writeIndex = 0;
+    int readIndex = 1;
+    std::atomic<int> middle { 2 };
+};
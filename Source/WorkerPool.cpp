@@ -0,0 +1,374 @@
+#include "WorkerPool.h"
+#include "RealtimeGuard.h"
+
+#if JUCE_LINUX
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#endif
+
+namespace
+{
+    constexpr juce::uint64 taskIndexMask = 0xffff;
+
+    int getNextTask(juce::uint64 tasks)     { return (int) (tasks & taskIndexMask); }
+    int getNumTasks(juce::uint64 tasks)     { return (int) ((tasks >> 16) & taskIndexMask); }
+}
+
+class WorkerPool::Worker : public juce::Thread
+{
+public:
+    explicit Worker(WorkerPool& workerPool) : juce::Thread("Shatter worker"), pool(workerPool)
+    {
+    }
+
+    void run() override
+    {
+        pool.runWorker(*this);
+    }
+
+private:
+    WorkerPool& pool;
+};
+
+// A counting semaphore that the audio thread can post without taking a lock, unlike
+// juce::WaitableEvent, whose signal() locks a mutex. Posting is a futex wake on Linux,
+// and goes to the system's semaphores on macOS and Windows.
+class WorkerPool::Semaphore
+{
+public:
+   #if JUCE_LINUX
+    void post(int count)
+    {
+        available.fetch_add(count);
+
+        if (numWaiting.load() > 0)
+        {
+            syscall(SYS_futex, reinterpret_cast<int*>(&available), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+        }
+    }
+
+    bool wait(int milliseconds)
+    {
+        auto deadline = juce::Time::getMillisecondCounterHiRes() + milliseconds;
+
+        for (;;)
+        {
+            for (int count = available.load(); count > 0;)
+            {
+                if (available.compare_exchange_weak(count, count - 1, std::memory_order_acquire))
+                {
+                    return true;
+                }
+            }
+
+            double remaining = deadline - juce::Time::getMillisecondCounterHiRes();
+
+            if (remaining <= 0.0)
+            {
+                return false;
+            }
+
+            // the kernel only sleeps if nothing was posted since the check above
+            timespec timeout { (time_t) (remaining / 1000.0), (long) (std::fmod(remaining, 1000.0) * 1.0e6) };
+            ++numWaiting;
+            syscall(SYS_futex, reinterpret_cast<int*>(&available), FUTEX_WAIT_PRIVATE, 0, &timeout, nullptr, 0);
+            --numWaiting;
+        }
+    }
+
+private:
+    std::atomic<int> available { 0 };
+    std::atomic<int> numWaiting { 0 };
+
+    static_assert(sizeof(std::atomic<int>) == sizeof(int), "the futex word is the atomic itself");
+   #elif JUCE_MAC || JUCE_IOS
+    Semaphore()     { semaphore = dispatch_semaphore_create(0); }
+    ~Semaphore()    { dispatch_release(semaphore); }
+
+    void post(int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            dispatch_semaphore_signal(semaphore);
+        }
+    }
+
+    bool wait(int milliseconds)     { return dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, (int64_t) milliseconds * NSEC_PER_MSEC)) == 0; }
+
+private:
+    dispatch_semaphore_t semaphore;
+   #elif JUCE_WINDOWS
+    Semaphore()     { semaphore = CreateSemaphoreW(nullptr, 0, std::numeric_limits<LONG>::max(), nullptr); }
+    ~Semaphore()    { CloseHandle(semaphore); }
+
+    void post(int count)            { ReleaseSemaphore(semaphore, count, nullptr); }
+    bool wait(int milliseconds)     { return WaitForSingleObject(semaphore, (DWORD) milliseconds) == WAIT_OBJECT_0; }
+
+private:
+    HANDLE semaphore;
+   #else
+    // no lock-free wake here, the event locks when it's signalled
+    void post(int)                  { event.signal(); }
+    bool wait(int milliseconds)     { return event.wait(milliseconds); }
+
+private:
+    juce::WaitableEvent event;
+   #endif
+};
+
+WorkerPool::WorkerPool() : workAvailable(std::make_unique<Semaphore>())
+{
+    // threads are only started once an instance is prepared, so scanning the plugin stays cheap
+    numWorkers = juce::jlimit(0, maxWorkers, juce::SystemStats::getNumPhysicalCpus() - 1);
+}
+
+WorkerPool::~WorkerPool()
+{
+    stopWorkers();
+}
+
+void WorkerPool::addUser()
+{
+    const juce::ScopedLock lock(userLock);
+
+    if (numUsers++ == 0)
+    {
+        startWorkers();
+    }
+}
+
+void WorkerPool::removeUser()
+{
+    const juce::ScopedLock lock(userLock);
+
+    if (--numUsers == 0)
+    {
+        stopWorkers();
+    }
+}
+
+void WorkerPool::setBlockPeriod(double seconds)
+{
+    // instances share the workers, so the shortest block decides
+    auto ticks = std::max<juce::int64>(1, juce::Time::secondsToHighResolutionTicks(seconds * spinBlockFraction));
+    auto current = spinTicks.load();
+
+    while ((current == 0 || ticks < current) && ! spinTicks.compare_exchange_weak(current, ticks))
+    {
+    }
+}
+
+int WorkerPool::getNumWorkers() const   { return isRunning ? numWorkers : 0; }
+
+void WorkerPool::runTasks(int numTasks, TaskFunction function, void* context)
+{
+    Job* job = nullptr;
+
+    if (numTasks > 1 && numTasks <= maxTasks && isRunning)
+    {
+        for (auto& slot : jobs)
+        {
+            bool isFree = false;
+
+            if (slot.isInUse.compare_exchange_strong(isFree, true, std::memory_order_acquire))
+            {
+                job = &slot;
+                break;
+            }
+        }
+    }
+
+    // one task, more than a job holds, no workers or every slot taken by other instances
+    if (job == nullptr)
+    {
+        for (int task = 0; task < numTasks; ++task)
+        {
+            function(context, task);
+        }
+
+        return;
+    }
+
+    job->function.store(function, std::memory_order_relaxed);
+    job->context.store(context, std::memory_order_relaxed);
+    job->numFinished.store(0, std::memory_order_relaxed);
+
+    auto generation = (juce::uint32) (job->tasks.load(std::memory_order_relaxed) >> 32) + 1;
+    job->tasks.store(((juce::uint64) generation << 32) | ((juce::uint64) numTasks << 16), std::memory_order_release);
+
+    // pairs with the fence in runWorker, either a worker going to sleep sees the job or this sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (int numToWake = std::min(numSleeping.load(), numTasks - 1); numToWake > 0)
+    {
+        workAvailable->post(numToWake);
+    }
+
+    while (tryRunTask(*job))
+    {
+    }
+
+    // a worker can be descheduled between claiming a task and starting it, those tasks are run here instead
+    for (int task = 0; task < numTasks; ++task)
+    {
+        if (startTask(*job, task, generation))
+        {
+            runTask(*job, function, context, task);
+        }
+    }
+
+    // what is left is already running on the workers, so this is at most one task long
+    while (job->numFinished.load(std::memory_order_acquire) < numTasks)
+    {
+    }
+
+    job->isInUse.store(false, std::memory_order_release);
+}
+
+bool WorkerPool::tryRunTask(Job& job)
+{
+    auto tasks = job.tasks.load(std::memory_order_acquire);
+    int task = getNextTask(tasks);
+
+    if (task >= getNumTasks(tasks))
+    {
+        return false;
+    }
+
+    // read before the claim, the job can't be replaced while it still has a task nobody has claimed
+    auto function = job.function.load(std::memory_order_relaxed);
+    auto context = job.context.load(std::memory_order_relaxed);
+
+    // lost to another thread, there may still be more
+    if (! job.tasks.compare_exchange_strong(tasks, tasks + 1, std::memory_order_acq_rel))
+    {
+        return true;
+    }
+
+    if (startTask(job, task, (juce::uint32) (tasks >> 32)))
+    {
+        runTask(job, function, context, task);
+    }
+
+    return true;
+}
+
+void WorkerPool::runTask(Job& job, TaskFunction function, void* context, int task)
+{
+    // a task is part of the audio callback whichever thread it runs on
+    RealtimeGuard::ScopedAudioThread audioThread;
+
+    function(context, task);
+    job.numFinished.fetch_add(1, std::memory_order_release);
+}
+
+bool WorkerPool::startTask(Job& job, int task, juce::uint32 generation)
+{
+    auto& started = job.startedGenerations[(size_t) task];
+    auto previous = started.load(std::memory_order_relaxed);
+
+    do
+    {
+        // started already, by the caller or by a later job in the same slot, the difference copes with wraparound
+        if ((juce::int32) (previous - generation) >= 0)
+        {
+            return false;
+        }
+    }
+    while (! started.compare_exchange_weak(previous, generation, std::memory_order_acq_rel));
+
+    return true;
+}
+
+bool WorkerPool::runPendingTask()
+{
+    for (auto& job : jobs)
+    {
+        if (job.isInUse.load(std::memory_order_relaxed) && tryRunTask(job))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkerPool::runWorker(Worker& worker)
+{
+    auto lastTaskTicks = juce::Time::getHighResolutionTicks();
+
+    while (! worker.threadShouldExit())
+    {
+        if (runPendingTask())
+        {
+            lastTaskTicks = juce::Time::getHighResolutionTicks();
+            continue;
+        }
+
+        if (juce::Time::getHighResolutionTicks() - lastTaskTicks < spinTicks.load(std::memory_order_relaxed))
+        {
+            juce::Thread::yield();
+            continue;
+        }
+
+        // counted before looking once more, so a job submitted meanwhile either gets seen here or posts the semaphore,
+        // a post that finds this worker already awake only makes its next wait return straight away
+        ++numSleeping;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (! runPendingTask())
+        {
+            workAvailable->wait(100);
+        }
+
+        --numSleeping;
+        lastTaskTicks = juce::Time::getHighResolutionTicks();
+    }
+}
+
+void WorkerPool::startWorkers()
+{
+    spinTicks = 0;
+
+    for (int i = 0; i < numWorkers; ++i)
+    {
+        auto worker = std::make_unique<Worker>(*this);
+
+        // real-time priority where the system allows it, the highest normal priority otherwise
+        if (! worker->startRealtimeThread(juce::Thread::RealtimeOptions()))
+        {
+            worker->startThread(juce::Thread::Priority::highest);
+        }
+
+        workers.push_back(std::move(worker));
+    }
+
+    isRunning = true;
+}
+
+void WorkerPool::stopWorkers()
+{
+    isRunning = false;
+
+    for (auto& worker : workers)
+    {
+        worker->signalThreadShouldExit();
+    }
+
+    workAvailable->post(numWorkers);
+
+    for (auto& worker : workers)
+    {
+        worker->stopThread(1000);
+    }
+
+    workers.clear();
+}
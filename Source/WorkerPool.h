@@ -0,0 +1,82 @@
+#pragma once
+#include <JuceHeader.h>
+
+// Worker threads shared by every plugin instance in the process through a
+// juce::SharedResourcePointer, one per physical core besides the one the
+// host's audio thread takes. An instance hands a job split into tasks to the
+// pool and works through it as well, so the job finishes even when every
+// worker is busy with other instances. Jobs sit in a fixed set of slots and
+// claiming a job or a task is lock-free, and so is waking the workers.
+class WorkerPool
+{
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    // not the audio thread, the workers only run while at least one instance is prepared
+    void addUser();
+    void removeUser();
+
+    // not the audio thread, the workers spin for a fraction of the shortest block period reported since they started
+    void setBlockPeriod(double seconds);
+
+    int getNumWorkers() const;
+
+    // audio thread, calls function(taskIndex) for every index below numTasks and returns once they have all finished,
+    // tasks can run on any thread in any order, a task a worker has claimed but not started is taken back
+    template <typename Function>
+    void run(int numTasks, Function& function)
+    {
+        runTasks(numTasks, [] (void* context, int taskIndex) { (*static_cast<Function*>(context))(taskIndex); }, &function);
+    }
+
+    static constexpr int maxWorkers = 15;
+    static constexpr int maxJobs = 64;
+    static constexpr int maxTasks = 64;
+
+private:
+    using TaskFunction = void (*)(void* context, int taskIndex);
+
+    class Worker;
+    class Semaphore;
+
+    struct Job
+    {
+        // generation in the top 32 bits, then the number of tasks and the next task to claim in 16 bits each,
+        // one word so a worker can never pair a task index with a job that has since been replaced
+        std::atomic<juce::uint64> tasks { 0 };
+        std::atomic<int> numFinished { 0 };
+        std::atomic<bool> isInUse { false };
+        std::atomic<TaskFunction> function { nullptr };
+        std::atomic<void*> context { nullptr };
+
+        // the last generation each task was started in, claiming a task and starting it are separate steps
+        // so the caller can start a task itself when the worker that claimed it hasn't got to it yet
+        std::array<std::atomic<juce::uint32>, maxTasks> startedGenerations {};
+    };
+
+    void runTasks(int numTasks, TaskFunction function, void* context);
+    bool tryRunTask(Job& job);
+    bool startTask(Job& job, int task, juce::uint32 generation);
+    static void runTask(Job& job, TaskFunction function, void* context, int task);
+    bool runPendingTask();
+    void runWorker(Worker& worker);
+
+    void startWorkers();
+    void stopWorkers();
+
+    int numWorkers = 0;
+    std::array<Job, maxJobs> jobs;
+
+    juce::CriticalSection userLock;
+    int numUsers = 0;
+    std::atomic<bool> isRunning { false };
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // workers spin for part of a block after their last task, so the tasks of a block that come
+    // in bursts find them awake, and then sleep until the next block wakes them
+    static constexpr double spinBlockFraction = 0.25;
+    std::atomic<juce::int64> spinTicks { 0 };
+    std::atomic<int> numSleeping { 0 };
+    std::unique_ptr<Semaphore> workAvailable;
+};
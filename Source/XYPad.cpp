@@ -0,0 +1,120 @@
+#include "XYPad.h"
+
+
+XYPad::XYPad(juce::AudioProcessorValueTreeState& valueTreeState, const juce::String& xParameterID, const juce::String& yParameterID)
+    : xAttachment(*valueTreeState.getParameter(xParameterID), [this] (float value) { xValue = value; repaint(); }),
+      yAttachment(*valueTreeState.getParameter(yParameterID), [this] (float value) { yValue = value; repaint(); })
+{
+    outlineThickness = 2;
+    curveAmount = 15;
+    
+    xAttachment.sendInitialUpdate();
+    yAttachment.sendInitialUpdate();
+}
+
+void XYPad::paint(juce::Graphics& g)
+{
+    auto bounds = getLocalBounds().reduced(outlineThickness).toFloat();
+    
+    g.setColour (juce::Colours::darkslategrey);
+    g.fillRoundedRectangle(bounds, curveAmount);
+    
+    g.setColour (juce::Colours::black);
+    g.drawRoundedRectangle(bounds, curveAmount, outlineThickness);
+    
+    auto padArea = getPadArea();
+    g.setColour (juce::Colours::white.withAlpha(0.2f));
+    g.drawRect(padArea, 1.0f);
+    
+    const char* cornerNames[] = { "A", "B", "C", "D" };
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        bool isFilled = isCornerFilled != nullptr && isCornerFilled(corner);
+        
+        g.setColour (isFilled ? juce::Colours::snow : juce::Colours::grey);
+        g.drawText(cornerNames[corner], juce::Rectangle<float>(20.0f, 20.0f).withCentre(getCornerPosition(corner)), juce::Justification::centred);
+    }
+    
+    juce::Point<float> puck(padArea.getX() + xValue * padArea.getWidth(), padArea.getBottom() - yValue * padArea.getHeight());
+    
+    g.setColour (juce::Colours::snow);
+    g.fillEllipse(juce::Rectangle<float>(14.0f, 14.0f).withCentre(puck));
+    
+    g.setColour (juce::Colours::darkred);
+    g.drawEllipse(juce::Rectangle<float>(14.0f, 14.0f).withCentre(puck), 2.0f);
+}
+
+void XYPad::mouseDown(const juce::MouseEvent& event)
+{
+    if (event.mods.isPopupMenu())
+    {
+        int corner = getCornerAt(event.position);
+        
+        if (corner >= 0 && onCornerMenuRequested != nullptr)
+        {
+            onCornerMenuRequested(corner);
+        }
+        
+        return;
+    }
+    
+    isDragging = true;
+    xAttachment.beginGesture();
+    yAttachment.beginGesture();
+    setValuesFromPosition(event.position);
+}
+
+void XYPad::mouseDrag(const juce::MouseEvent& event)
+{
+    if (isDragging)
+    {
+        setValuesFromPosition(event.position);
+    }
+}
+
+void XYPad::mouseUp(const juce::MouseEvent&)
+{
+    if (isDragging)
+    {
+        xAttachment.endGesture();
+        yAttachment.endGesture();
+        isDragging = false;
+    }
+}
+
+juce::Rectangle<float> XYPad::getPadArea() const
+{
+    return getLocalBounds().toFloat().reduced(curveAmount + 10.0f);
+}
+
+juce::Point<float> XYPad::getCornerPosition(int corner) const
+{
+    // A and B along the bottom, C and D along the top
+    auto labelArea = getPadArea().expanded(10.0f);
+    
+    return { corner % 2 == 0 ? labelArea.getX() : labelArea.getRight(),
+             corner < 2 ? labelArea.getBottom() : labelArea.getY() };
+}
+
+int XYPad::getCornerAt(juce::Point<float> position) const
+{
+    int closestCorner = 0;
+    
+    for (int corner = 1; corner < 4; ++corner)
+    {
+        if (position.getDistanceFrom(getCornerPosition(corner)) < position.getDistanceFrom(getCornerPosition(closestCorner)))
+        {
+            closestCorner = corner;
+        }
+    }
+    
+    return position.getDistanceFrom(getCornerPosition(closestCorner)) < getPadArea().getWidth() / 3 ? closestCorner : -1;
+}
+
+void XYPad::setValuesFromPosition(juce::Point<float> position)
+{
+    auto padArea = getPadArea();
+    
+    xAttachment.setValueAsPartOfGesture(juce::jlimit(0.0f, 1.0f, (position.x - padArea.getX()) / padArea.getWidth()));
+    yAttachment.setValueAsPartOfGesture(juce::jlimit(0.0f, 1.0f, (padArea.getBottom() - position.y) / padArea.getHeight()));
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Two parameters on one square pad. Corners are labelled A to D,
+// right-clicking near one asks the owner what to do with it.
+class XYPad : public juce::Component
+{
+public:
+    XYPad(juce::AudioProcessorValueTreeState& valueTreeState, const juce::String& xParameterID, const juce::String& yParameterID);
+    
+    void paint(juce::Graphics& g) override;
+    
+    void mouseDown(const juce::MouseEvent& event) override;
+    void mouseDrag(const juce::MouseEvent& event) override;
+    void mouseUp(const juce::MouseEvent& event) override;
+    
+    std::function<bool(int corner)> isCornerFilled;
+    std::function<void(int corner)> onCornerMenuRequested;
+    
+private:
+    juce::Rectangle<float> getPadArea() const;
+    juce::Point<float> getCornerPosition(int corner) const;
+    int getCornerAt(juce::Point<float> position) const;
+    void setValuesFromPosition(juce::Point<float> position);
+    
+    juce::ParameterAttachment xAttachment;
+    juce::ParameterAttachment yAttachment;
+    
+    float xValue = 0.5f;
+    float yValue = 0.5f;
+    bool isDragging = false;
+    
+    int outlineThickness;
+    int curveAmount;
+};
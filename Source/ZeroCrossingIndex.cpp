@@ -0,0 +1,134 @@
+#include "ZeroCrossingIndex.h"
+
+namespace
+{
+    int findHighestSetBit(juce::uint64 word)
+    {
+        auto high = (juce::uint32) (word >> 32);
+        return high != 0 ? 32 + juce::findHighestSetBit(high) : juce::findHighestSetBit((juce::uint32) word);
+    }
+
+    int findLowestSetBit(juce::uint64 word)
+    {
+        return findHighestSetBit(word & (~word + 1));
+    }
+
+    // bits from first up to and including last
+    juce::uint64 getMask(int first, int last)
+    {
+        juce::uint64 upTo = last == 63 ? ~(juce::uint64) 0 : ((juce::uint64) 1 << (last + 1)) - 1;
+        return upTo & ~(((juce::uint64) 1 << first) - 1);
+    }
+}
+
+void ZeroCrossingIndex::prepare(int ringBufferSize)
+{
+    bufferSize = ringBufferSize;
+    wasPositive = true;
+    bits.assign((size_t) (bufferSize + 63) / 64, 0);
+}
+
+void ZeroCrossingIndex::release()
+{
+    bufferSize = 0;
+    std::vector<juce::uint64>().swap(bits);
+}
+
+template <typename SampleType>
+void ZeroCrossingIndex::update(const SampleType* const* ringBuffer, int numChannels, int startSample, int numSamples)
+{
+    int position = startSample;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float sum = 0.0f;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            sum += toFloat(ringBuffer[channel][position]);
+        }
+
+        bool isPositive = sum >= 0.0f;
+        auto bit = (juce::uint64) 1 << (position % 64);
+        auto& word = bits[(size_t) (position / 64)];
+
+        word = isPositive != wasPositive ? word | bit : word & ~bit;
+        wasPositive = isPositive;
+
+        if (++position == bufferSize)
+        {
+            position = 0;
+        }
+    }
+}
+
+int ZeroCrossingIndex::findNearest(int position, int maxBefore, int maxAfter) const
+{
+    int previous = findPrevious(position, maxBefore);
+    int next = findNext(position, maxAfter);
+
+    if (previous < 0 || next < 0)
+    {
+        return previous < 0 ? next : previous;
+    }
+
+    int distanceBefore = (position - previous + bufferSize) % bufferSize;
+    int distanceAfter = (next - position + bufferSize) % bufferSize;
+
+    return distanceBefore <= distanceAfter ? previous : next;
+}
+
+int ZeroCrossingIndex::findPrevious(int position, int maxDistance) const
+{
+    // a word at a time, wrapping round from the start of the ring to its end
+    while (maxDistance >= 0)
+    {
+        int bit = position % 64;
+        int firstBit = std::max(0, bit - maxDistance);
+        auto found = bits[(size_t) (position / 64)] & getMask(firstBit, bit);
+
+        if (found != 0)
+        {
+            return position - bit + findHighestSetBit(found);
+        }
+
+        maxDistance -= bit + 1;
+        position = position - bit - 1;
+
+        if (position < 0)
+        {
+            position = bufferSize - 1;
+        }
+    }
+
+    return -1;
+}
+
+int ZeroCrossingIndex::findNext(int position, int maxDistance) const
+{
+    while (maxDistance >= 0)
+    {
+        // bits past the end of the ring are never set
+        int bit = position % 64;
+        int lastBit = std::min(63, bit + maxDistance);
+        auto found = bits[(size_t) (position / 64)] & getMask(bit, lastBit);
+
+        if (found != 0)
+        {
+            return position - bit + findLowestSetBit(found);
+        }
+
+        maxDistance -= 64 - bit;
+        position = position - bit + 64;
+
+        if (position >= bufferSize)
+        {
+            position = 0;
+        }
+    }
+
+    return -1;
+}
+
+template void ZeroCrossingIndex::update<float>(const float* const*, int, int, int);
+template void ZeroCrossingIndex::update<Float16>(const Float16* const*, int, int, int);
@@ -0,0 +1,30 @@
+#pragma once
+#include <JuceHeader.h>
+#include "Float16.h"
+
+// One bit per sample of a ring buffer, set where the sum of its channels
+// changes sign. Kept up to date as blocks are written, so the crossing
+// nearest a position is found by scanning at most a few 64 bit words.
+class ZeroCrossingIndex
+{
+public:
+    void prepare(int ringBufferSize);
+    void release();
+
+    // call after writing to the ring buffer, blocks have to follow on from each other,
+    // the ring buffer's channels can hold float or Float16 samples
+    template <typename SampleType>
+    void update(const SampleType* const* ringBuffer, int numChannels, int startSample, int numSamples);
+
+    // the crossing closest to position, no more than maxBefore samples before it or maxAfter samples after, -1 if there is none
+    int findNearest(int position, int maxBefore, int maxAfter) const;
+
+private:
+    int findPrevious(int position, int maxDistance) const;
+    int findNext(int position, int maxDistance) const;
+
+    int bufferSize = 0;
+    bool wasPositive = true;    // sign of the last sample written
+
+    std::vector<juce::uint64> bits;
+};
@@ -0,0 +1,183 @@
+#include <JuceHeader.h>
+#include <iostream>
+#include "../../Source/PluginProcessor.h"
+#include "../../Source/RealtimeGuard.h"
+
+#if ! SHATTER_RT_GUARD
+ #error "the validator needs SHATTER_RT_GUARD=1 to see anything"
+#endif
+
+// RealtimeValidator [--seed n] [--configurations n] [--seconds n]
+// drives processBlock through random sample rates, block sizes, program changes and automation with
+// the realtime guard watching, and returns 1 when the audio thread allocated or locked, or when
+// automation stopped reaching the engine
+namespace
+{
+    const double sampleRates[] = { 44100.0, 48000.0, 88200.0, 96000.0, 192000.0 };
+    const int maximumBlockSizes[] = { 32, 64, 128, 256, 441, 512, 1024, 2048, 4096 };
+
+    template <typename Type, size_t size>
+    Type pick(juce::Random& random, const Type (&choices)[size])
+    {
+        return choices[random.nextInt((int) size)];
+    }
+
+    void fillWithNoise(juce::AudioBuffer<float>& buffer, juce::Random& random)
+    {
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        {
+            auto* samples = buffer.getWritePointer(channel);
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                samples[i] = (random.nextFloat() * 2.0f - 1.0f) * 0.25f;
+            }
+        }
+    }
+
+    // the program change is handed over on the message thread, which nothing else here runs
+    void dispatchMessages()
+    {
+        juce::MessageManager::getInstance()->runDispatchLoopUntil(10);
+    }
+
+    // automates the grain size on the audio thread and checks the engine has it after the next block,
+    // which fails if a program change were never handed back to the parameters
+    bool checkAutomationReachesEngine(ShatterAudioProcessor& processor, juce::Random& random, juce::AudioBuffer<float>& buffer)
+    {
+        juce::MidiBuffer midi;
+        auto* size = processor.apvts.getParameter("SIZE");
+        float value = random.nextFloat();
+
+        {
+            RealtimeGuard::ScopedAudioThread audioThread;
+
+            // the morph pads blend over the parameters, so they're switched off for the check
+            processor.apvts.getParameter("MORPH")->setValue(0.0f);
+            size->setValue(value);
+            processor.processBlock(buffer, midi);
+        }
+
+        double expected = size->convertFrom0to1(value);
+
+        if (std::abs(processor.grainMill->getGrainSize() - expected) > 1.0e-4 * expected)
+        {
+            std::cout << "automated size " << expected << " didn't reach the engine, it has " << processor.grainMill->getGrainSize() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // returns false when automation didn't reach the engine
+    bool runConfiguration(ShatterAudioProcessor& processor, juce::Random& random, double seconds)
+    {
+        double sampleRate = pick(random, sampleRates);
+        int maximumBlockSize = pick(random, maximumBlockSizes);
+
+        // storage and history are switched between runs, the way an editor would
+        processor.setDelayStorage(random.nextBool() ? DelayStorage::float16 : DelayStorage::float32);
+        processor.setLongHistory(random.nextInt(4) == 0 ? 60.0 : 0.0);
+
+        std::cout << sampleRate << " Hz, blocks up to " << maximumBlockSize << ", "
+                  << (processor.getDelayStorage() == DelayStorage::float16 ? "float16" : "float32")
+                  << (processor.getLongHistory() > 0.0 ? ", long history" : "") << std::endl;
+
+        processor.setPlayConfigDetails(2, 2, sampleRate, maximumBlockSize);
+        processor.prepareToPlay(sampleRate, maximumBlockSize);
+
+        juce::AudioBuffer<float> buffer(2, maximumBlockSize);
+        juce::MidiBuffer midi;
+        auto& parameters = processor.getParameters();
+
+        int programChangeBlock = random.nextInt(64);
+        int block = 0;
+
+        for (int samplesLeft = (int) (seconds * sampleRate); samplesLeft > 0; ++block)
+        {
+            // a program change partway in, from the message thread as an editor or host would send it
+            if (block == programChangeBlock)
+            {
+                processor.setCurrentProgram(random.nextInt(processor.getNumPrograms()));
+            }
+
+            // hosts send odd and single sample blocks as well as full ones
+            int numSamples = random.nextInt(4) == 0 ? maximumBlockSize : 1 + random.nextInt(maximumBlockSize);
+            numSamples = std::min(numSamples, samplesLeft);
+            samplesLeft -= numSamples;
+
+            buffer.setSize(2, numSamples, false, false, true);
+            fillWithNoise(buffer, random);
+
+            {
+                // automation arrives on the audio thread, right before the block
+                RealtimeGuard::ScopedAudioThread audioThread;
+
+                for (int i = random.nextInt(4); --i >= 0;)
+                {
+                    parameters[random.nextInt(parameters.size())]->setValue(random.nextFloat());
+                }
+
+                processor.processBlock(buffer, midi);
+            }
+
+            if (block == programChangeBlock)
+            {
+                dispatchMessages();
+            }
+        }
+
+        // the program change has been handed back by now, so the parameters are in charge again
+        dispatchMessages();
+        buffer.setSize(2, maximumBlockSize, false, false, true);
+        fillWithNoise(buffer, random);
+
+        bool hasReachedEngine = checkAutomationReachesEngine(processor, random, buffer) && checkAutomationReachesEngine(processor, random, buffer);
+
+        processor.releaseResources();
+        return hasReachedEngine;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray arguments;
+    for (int i = 1; i < argc; ++i)
+    {
+        arguments.add(argv[i]);
+    }
+
+    auto getOption = [&arguments] (const juce::String& name, const juce::String& defaultValue)
+    {
+        int index = arguments.indexOf(name);
+        return index >= 0 && index + 1 < arguments.size() ? arguments[index + 1] : defaultValue;
+    };
+
+    auto seed = getOption("--seed", juce::String(juce::Time::currentTimeMillis())).getLargeIntValue();
+    int numConfigurations = getOption("--configurations", "20").getIntValue();
+    double seconds = getOption("--seconds", "2").getDoubleValue();
+
+    std::cout << "seed " << seed << std::endl;
+    juce::Random random(seed);
+
+    ShatterAudioProcessor processor;
+
+    // programs switch straight away, so the automation check at the end of a run never lands mid-morph
+    processor.setPresetMorphTime(0.0f);
+
+    int numUnappliedConfigurations = 0;
+
+    for (int configuration = 0; configuration < numConfigurations; ++configuration)
+    {
+        if (! runConfiguration(processor, random, seconds))
+        {
+            ++numUnappliedConfigurations;
+        }
+    }
+
+    int numViolations = RealtimeGuard::getNumViolations();
+    std::cout << numViolations << " allocations or locks on the audio thread" << std::endl;
+    std::cout << numUnappliedConfigurations << " runs where automation didn't reach the engine" << std::endl;
+    return numViolations == 0 && numUnappliedConfigurations == 0 ? 0 : 1;
+}